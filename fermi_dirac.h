@@ -8,6 +8,9 @@
 *  For more details, refer to https://github.com/wullm/AnyRNG.
 */
 
+#include <stddef.h>
+#include <math.h>
+
 /* Cubic spline coefficients */
 struct spline {
   float a0, a1, a2, a3;
@@ -22,44 +25,54 @@ struct anyrng {
   float *index_table;
 };
 
-static float endpoints[118] = {
-  0.000000e+00, 8.812220e-16, 3.490090e-15, 1.764874e-14, 1.080345e-13, 
-  7.475047e-13, 5.544411e-12, 4.267185e-11, 3.346975e-10, 2.649997e-09, 
-  2.107211e-08, 7.092068e-08, 1.677779e-07, 5.644860e-07, 1.334411e-06, 
-  2.599613e-06, 4.480999e-06, 1.057018e-05, 2.054614e-05, 3.533463e-05, 
-  5.584298e-05, 8.296016e-05, 1.175567e-04, 1.604850e-04, 2.125789e-04, 
-  2.746542e-04, 4.319210e-04, 6.384483e-04, 9.001106e-04, 1.222496e-03, 
-  1.610910e-03, 2.070375e-03, 2.605637e-03, 3.221165e-03, 3.921158e-03, 
-  4.709548e-03, 5.590000e-03, 6.565923e-03, 8.816531e-03, 1.148360e-02, 
-  1.458549e-02, 1.813688e-02, 2.214891e-02, 2.662937e-02, 3.158292e-02, 
-  3.701122e-02, 4.291319e-02, 4.928517e-02, 5.612111e-02, 6.341282e-02, 
-  7.115008e-02, 8.791173e-02, 1.062920e-01, 1.261570e-01, 1.473582e-01, 
-  1.697373e-01, 1.931305e-01, 2.173724e-01, 2.422994e-01, 2.677516e-01, 
-  2.935760e-01, 3.196273e-01, 3.457697e-01, 3.718776e-01, 3.978360e-01, 
-  4.235411e-01, 4.488999e-01, 4.738305e-01, 5.221310e-01, 5.679885e-01, 
-  6.110917e-01, 6.512521e-01, 6.883826e-01, 7.224780e-01, 7.535962e-01, 
-  7.818432e-01, 8.073587e-01, 8.303052e-01, 8.508587e-01, 8.692016e-01, 
-  8.855172e-01, 8.999850e-01, 9.127781e-01, 9.240609e-01, 9.339876e-01, 
-  9.427015e-01, 9.503348e-01, 9.570084e-01, 9.628322e-01, 9.679056e-01, 
-  9.723182e-01, 9.761502e-01, 9.794730e-01, 9.823505e-01, 9.848391e-01, 
-  9.869886e-01, 9.888431e-01, 9.904414e-01, 9.918172e-01, 9.930005e-01, 
-  9.948897e-01, 9.962793e-01, 9.972980e-01, 9.980425e-01, 9.985850e-01, 
-  9.989794e-01, 9.992652e-01, 9.994720e-01, 9.996213e-01, 9.998061e-01, 
-  9.999013e-01, 9.999500e-01, 9.999748e-01, 9.999937e-01, 9.999984e-01, 
-  9.999996e-01, 9.999999e-01, 1.000000e+00};
-static struct spline splines[118] = {
-  {1.000000e-05, 3.177853e-05, -3.440759e-05, 1.454999e-05},
-  {2.192092e-05, 1.957877e-05, -1.160959e-05, 3.951739e-06},
-  {3.384185e-05, 4.458279e-05, -3.298529e-05, 1.224435e-05},
-  {5.768370e-05, 9.796089e-05, -8.223074e-05, 3.195355e-05},
-  {1.053674e-04, 2.077194e-04, -1.865719e-04, 7.421998e-05},
-  {2.007348e-04, 4.293444e-04, -3.993851e-04, 1.607755e-04},
-  {3.914696e-04, 8.738366e-04, -8.274556e-04, 3.350886e-04},
-  {7.729391e-04, 1.763374e-03, -1.684705e-03, 6.842694e-04},
-  {1.535878e-03, 3.542204e-03, -3.398798e-03, 1.382473e-03},
-  {3.061757e-03, 7.097573e-03, -6.822804e-03, 2.776987e-03},
-  {6.113513e-03, 4.824439e-03, -2.643433e-03, 8.707511e-04},
-  {9.165270e-03, 4.177172e-03, -1.553626e-03, 4.282101e-04},
+/* Evaluate the cubic a0 + a1 * t + a2 * t^2 + a3 * t^3. If
+ * ANYRNG_DETERMINISTIC is defined, Horner's scheme is used with explicit
+ * fused multiply-adds, such that all transform methods give bitwise
+ * identical results on any instruction set. */
+static inline double anyrng_cubic(double a0, double a1, double a2, double a3,
+                                  double t) {
+#ifdef ANYRNG_DETERMINISTIC
+  return fma(t, fma(t, fma(t, a3, a2), a1), a0);
+#else
+  return a0 + a1 * t + a2 * t * t + a3 * t * t * t;
+#endif
+}
+
+/* Single-precision version of anyrng_cubic, using Horner's scheme */
+static inline float anyrng_cubicf(float a0, float a1, float a2, float a3,
+                                  float t) {
+#ifdef ANYRNG_DETERMINISTIC
+  return fmaf(t, fmaf(t, fmaf(t, a3, a2), a1), a0);
+#else
+  return a0 + t * (a1 + t * (a2 + t * a3));
+#endif
+}
+
+static float endpoints[107] = {
+  0.000000e+00, 1.677779e-07, 5.644860e-07, 1.334411e-06, 2.599613e-06, 
+  4.480999e-06, 1.057018e-05, 2.054614e-05, 3.533463e-05, 5.584298e-05, 
+  8.296016e-05, 1.175567e-04, 1.604850e-04, 2.125789e-04, 2.746542e-04, 
+  4.319210e-04, 6.384483e-04, 9.001106e-04, 1.222496e-03, 1.610910e-03, 
+  2.070375e-03, 2.605637e-03, 3.221165e-03, 3.921158e-03, 4.709548e-03, 
+  5.590000e-03, 6.565923e-03, 8.816531e-03, 1.148360e-02, 1.458549e-02, 
+  1.813688e-02, 2.214891e-02, 2.662937e-02, 3.158292e-02, 3.701122e-02, 
+  4.291319e-02, 4.928517e-02, 5.612111e-02, 6.341282e-02, 7.115008e-02, 
+  8.791173e-02, 1.062920e-01, 1.261570e-01, 1.473582e-01, 1.697373e-01, 
+  1.931305e-01, 2.173724e-01, 2.422994e-01, 2.677516e-01, 2.935760e-01, 
+  3.196273e-01, 3.457697e-01, 3.718776e-01, 3.978360e-01, 4.235411e-01, 
+  4.488999e-01, 4.738305e-01, 5.221310e-01, 5.679885e-01, 6.110917e-01, 
+  6.512521e-01, 6.883826e-01, 7.224780e-01, 7.535962e-01, 7.818432e-01, 
+  8.073587e-01, 8.303052e-01, 8.508587e-01, 8.692016e-01, 8.855172e-01, 
+  8.999850e-01, 9.127781e-01, 9.240609e-01, 9.339876e-01, 9.427015e-01, 
+  9.503348e-01, 9.570084e-01, 9.628322e-01, 9.679056e-01, 9.723182e-01, 
+  9.761502e-01, 9.794730e-01, 9.823505e-01, 9.848391e-01, 9.869886e-01, 
+  9.888431e-01, 9.904414e-01, 9.918172e-01, 9.930005e-01, 9.948897e-01, 
+  9.962793e-01, 9.972980e-01, 9.980425e-01, 9.985850e-01, 9.989794e-01, 
+  9.992652e-01, 9.994720e-01, 9.996213e-01, 9.998061e-01, 9.999013e-01, 
+  9.999500e-01, 9.999748e-01, 9.999937e-01, 9.999984e-01, 9.999996e-01, 
+  9.999999e-01, 1.000000e+00};
+static struct spline splines[106] = {
+  {1.000000e-05, 1.220703e-02, 0.000000e+00, 0.000000e+00},
   {1.221703e-02, 9.643782e-03, -5.278698e-03, 1.738429e-03},
   {1.832054e-02, 8.348620e-03, -3.098591e-03, 8.534846e-04},
   {2.442405e-02, 7.742955e-03, -2.147031e-03, 5.075889e-04},
@@ -164,21 +177,9 @@ static struct spline splines[118] = {
   {1.718750e+01, 8.456524e-01, -3.938066e-01, 1.110653e+00},
   {1.875000e+01, 8.409733e-01, -4.130061e-01, 1.134532e+00},
   {2.031250e+01, 8.371720e-01, -4.305845e-01, 1.155912e+00},
-  {2.187500e+01, 8.346323e-01, -4.503617e-01, 1.178229e+00},
-  {2.343750e+01, 8.359434e-01, -4.895204e-01, 1.216076e+00}};
-static struct spline f_splines[118] = {
-  {2.773011e-11, 1.762440e-10, -1.163284e-10, 4.560414e-11},
-  {1.332498e-10, 2.380241e-10, -7.723341e-11, 2.354048e-11},
-  {3.175810e-10, 8.367466e-10, -3.491194e-10, 1.174638e-10},
-  {9.226720e-10, 3.133796e-09, -1.515606e-09, 5.376669e-10},
-  {3.078529e-09, 1.213759e-08, -6.363860e-09, 2.320367e-09},
-  {1.117263e-08, 4.779107e-08, -2.614127e-08, 9.665411e-09},
-  {4.248785e-08, 1.896638e-07, -1.060223e-07, 3.947681e-08},
-  {1.656061e-07, 7.554778e-07, -4.270020e-07, 1.595507e-07},
-  {6.536326e-07, 3.013793e-06, -1.713070e-06, 6.411953e-07},
-  {2.595552e-06, 1.202447e-05, -6.855505e-06, 2.567997e-06},
-  {1.033251e-05, 1.628267e-05, -4.853749e-06, 1.425834e-06},
-  {2.318726e-05, 2.108705e-05, -4.134772e-06, 9.966237e-07},
+  {2.187500e+01, 3.124999e+00, 0.000000e+00, 0.000000e+00}};
+static struct spline f_splines[106] = {
+  {2.773011e-11, 4.113613e-05, 0.000000e+00, 0.000000e+00},
   {4.113616e-05, 6.474393e-05, -1.933813e-05, 5.679879e-06},
   {9.222184e-05, 8.366199e-05, -1.644501e-05, 3.961608e-06},
   {1.634004e-04, 1.029626e-04, -1.492493e-05, 3.044708e-06},
@@ -283,31 +284,30 @@ static struct spline f_splines[118] = {
   {5.623044e-06, -4.201816e-06, -9.485883e-09, -9.046264e-09},
   {1.402697e-06, -1.053803e-06, -1.801069e-09, -2.025627e-09},
   {3.450667e-07, -2.604366e-07, -2.017978e-10, -5.426961e-10},
-  {8.388563e-08, -6.361241e-08, 1.621356e-10, -2.503403e-10},
-  {2.018502e-08, -1.543366e-08, 2.777685e-10, -2.151764e-10}};
+  {8.388563e-08, -7.907168e-08, 0.000000e+00, 0.000000e+00}};
 static float index_table[100] = {
-  0.000000e+00, 3.700000e+01, 4.000000e+01, 4.200000e+01, 4.400000e+01, 
-  4.600000e+01, 4.700000e+01, 4.800000e+01, 4.900000e+01, 5.000000e+01, 
-  5.000000e+01, 5.100000e+01, 5.100000e+01, 5.200000e+01, 5.200000e+01, 
-  5.300000e+01, 5.300000e+01, 5.400000e+01, 5.400000e+01, 5.400000e+01, 
-  5.500000e+01, 5.500000e+01, 5.600000e+01, 5.600000e+01, 5.600000e+01, 
+  0.000000e+00, 2.600000e+01, 2.900000e+01, 3.100000e+01, 3.300000e+01, 
+  3.500000e+01, 3.600000e+01, 3.700000e+01, 3.800000e+01, 3.900000e+01, 
+  3.900000e+01, 4.000000e+01, 4.000000e+01, 4.100000e+01, 4.100000e+01, 
+  4.200000e+01, 4.200000e+01, 4.300000e+01, 4.300000e+01, 4.300000e+01, 
+  4.400000e+01, 4.400000e+01, 4.500000e+01, 4.500000e+01, 4.500000e+01, 
+  4.600000e+01, 4.600000e+01, 4.700000e+01, 4.700000e+01, 4.700000e+01, 
+  4.800000e+01, 4.800000e+01, 4.900000e+01, 4.900000e+01, 4.900000e+01, 
+  5.000000e+01, 5.000000e+01, 5.000000e+01, 5.100000e+01, 5.100000e+01, 
+  5.200000e+01, 5.200000e+01, 5.200000e+01, 5.300000e+01, 5.300000e+01, 
+  5.400000e+01, 5.400000e+01, 5.400000e+01, 5.500000e+01, 5.500000e+01, 
+  5.500000e+01, 5.500000e+01, 5.500000e+01, 5.600000e+01, 5.600000e+01, 
+  5.600000e+01, 5.600000e+01, 5.700000e+01, 5.700000e+01, 5.700000e+01, 
   5.700000e+01, 5.700000e+01, 5.800000e+01, 5.800000e+01, 5.800000e+01, 
-  5.900000e+01, 5.900000e+01, 6.000000e+01, 6.000000e+01, 6.000000e+01, 
-  6.100000e+01, 6.100000e+01, 6.100000e+01, 6.200000e+01, 6.200000e+01, 
-  6.300000e+01, 6.300000e+01, 6.300000e+01, 6.400000e+01, 6.400000e+01, 
-  6.500000e+01, 6.500000e+01, 6.500000e+01, 6.600000e+01, 6.600000e+01, 
-  6.600000e+01, 6.600000e+01, 6.600000e+01, 6.700000e+01, 6.700000e+01, 
-  6.700000e+01, 6.700000e+01, 6.800000e+01, 6.800000e+01, 6.800000e+01, 
-  6.800000e+01, 6.800000e+01, 6.900000e+01, 6.900000e+01, 6.900000e+01, 
-  6.900000e+01, 7.000000e+01, 7.000000e+01, 7.000000e+01, 7.100000e+01, 
-  7.100000e+01, 7.100000e+01, 7.100000e+01, 7.200000e+01, 7.200000e+01, 
-  7.200000e+01, 7.300000e+01, 7.300000e+01, 7.300000e+01, 7.400000e+01, 
-  7.400000e+01, 7.500000e+01, 7.500000e+01, 7.500000e+01, 7.600000e+01, 
-  7.600000e+01, 7.700000e+01, 7.800000e+01, 7.800000e+01, 7.900000e+01, 
-  8.000000e+01, 8.000000e+01, 8.100000e+01, 8.200000e+01, 8.300000e+01, 
-  8.400000e+01, 8.600000e+01, 8.800000e+01, 9.100000e+01, 9.500000e+01
+  5.800000e+01, 5.900000e+01, 5.900000e+01, 5.900000e+01, 6.000000e+01, 
+  6.000000e+01, 6.000000e+01, 6.000000e+01, 6.100000e+01, 6.100000e+01, 
+  6.100000e+01, 6.200000e+01, 6.200000e+01, 6.200000e+01, 6.300000e+01, 
+  6.300000e+01, 6.400000e+01, 6.400000e+01, 6.400000e+01, 6.500000e+01, 
+  6.500000e+01, 6.600000e+01, 6.700000e+01, 6.700000e+01, 6.800000e+01, 
+  6.900000e+01, 6.900000e+01, 7.000000e+01, 7.100000e+01, 7.200000e+01, 
+  7.300000e+01, 7.500000e+01, 7.700000e+01, 8.000000e+01, 8.400000e+01
   };
-static struct anyrng anyrng = {endpoints, splines, f_splines, 118, index_table};
+static struct anyrng anyrng = {endpoints, splines, f_splines, 106, index_table};
 
 /**
 * @brief Transform a uniform random number into a custom variate X = F^-1(u)
@@ -332,12 +332,38 @@ static inline double transform_variate(double u) {
 
   /* Evaluate F^-1(u) using the Hermite approximation of F in this interval */
   double u_tilde = (u - Fl) / (Fr - Fl);
-  double H = iv->a0 + iv->a1 * u_tilde + iv->a2 * u_tilde * u_tilde +
-             iv->a3 * u_tilde * u_tilde * u_tilde;
+  double H = anyrng_cubic(iv->a0, iv->a1, iv->a2, iv->a3, u_tilde);
 
   return H;
 }
 
+/**
+* @brief Transform a uniform random number into a custom variate X = F^-1(u)
+* using only single-precision arithmetic
+*
+* @param u Random number to be transformed
+*/
+static inline float transform_variatef(float u) {
+  /* Use the search table to find a nearby interval */
+  int tablength = 100;
+  int int_u = (int)(u * tablength);
+  int start = anyrng.index_table[int_u < tablength ? int_u : tablength - 1];
+  int i;
+
+  /* Find the exact interval, i.e. the largest interval such that u > F(p) */
+  for (i = start; i < anyrng.intervalNum-1; i++) {
+    if (anyrng.endpoints[i+1] >= u) break;
+  }
+
+  float Fl = anyrng.endpoints[i];
+  float Fr = anyrng.endpoints[i+1];
+  struct spline *iv = &anyrng.splines[i];
+
+  /* Evaluate F^-1(u) using Horner's scheme in single precision */
+  float u_tilde = (u - Fl) / (Fr - Fl);
+  return anyrng_cubicf(iv->a0, iv->a1, iv->a2, iv->a3, u_tilde);
+}
+
 /**
 * @brief Transform a uniform random number into a custom variate X = F^-1(u)
 * and evaluate the probability density at f(X) 
@@ -362,8 +388,174 @@ static inline double transform_density(double u) {
 
   /* Evaluate f(F^-1(u)) using the Hermite approximation of f */
   double u_tilde = (u - Fl) / (Fr - Fl);
-  double H = iv->a0 + iv->a1 * u_tilde + iv->a2 * u_tilde * u_tilde +
-             iv->a3 * u_tilde * u_tilde * u_tilde;
+  double H = anyrng_cubic(iv->a0, iv->a1, iv->a2, iv->a3, u_tilde);
 
   return H;
 }
+
+/**
+* @brief Transform a uniform random number into a custom variate X = F^-1(u)
+* and evaluate the probability density f(X), with a single interval search
+*
+* @param u Random number to be transformed
+* @param density Output, the probability density at X
+*/
+static inline double transform_variate_and_density(double u, double *density) {
+  /* Use the search table to find a nearby interval */
+  int tablength = 100;
+  int int_u = (int)(u * tablength);
+  int start = anyrng.index_table[int_u < tablength ? int_u : tablength - 1];
+  int i;
+
+  /* Find the exact interval, i.e. the largest interval such that u > F(p) */
+  for (i = start; i < anyrng.intervalNum-1; i++) {
+    if (anyrng.endpoints[i+1] >= u) break;
+  }
+
+  float Fl = anyrng.endpoints[i];
+  float Fr = anyrng.endpoints[i+1];
+  struct spline *iv = &anyrng.splines[i];
+  struct spline *fv = &anyrng.pdf_splines[i];
+
+  /* Evaluate F^-1(u) and f(F^-1(u)) in the same interval */
+  double u_tilde = (u - Fl) / (Fr - Fl);
+  *density = anyrng_cubic(fv->a0, fv->a1, fv->a2, fv->a3, u_tilde);
+  return anyrng_cubic(iv->a0, iv->a1, iv->a2, iv->a3, u_tilde);
+}
+
+/* Number of variates that are searched in lockstep by the batch kernels */
+#define ANYRNG_BATCH_BLOCK 64
+
+/**
+* @brief Shared body of the batch kernels, which is compiled for each
+* instruction set by inlining it into the target-specific kernels below
+*
+* @param u Array of random numbers to be transformed
+* @param x Output array of custom variates
+* @param density Optional output array of densities, or NULL
+* @param n Number of random numbers
+*/
+static inline __attribute__((always_inline)) void
+anyrng_batch_kernel(const double *u, double *x, double *density, int n) {
+  const int tablength = 100;
+  const int last = anyrng.intervalNum - 1;
+  const float *ends = anyrng.endpoints;
+  const float *guide = anyrng.index_table;
+  const struct spline *inv = anyrng.splines;
+  const struct spline *dens = anyrng.pdf_splines;
+  int idx[ANYRNG_BATCH_BLOCK];
+
+  for (int k = 0; k < n; k += ANYRNG_BATCH_BLOCK) {
+    const int m = (n - k < ANYRNG_BATCH_BLOCK) ? n - k : ANYRNG_BATCH_BLOCK;
+    const double *uk = u + k;
+
+    /* Use the search table to find a nearby interval in every lane */
+    for (int j = 0; j < m; j++) {
+      int int_u = (int)(uk[j] * tablength);
+      idx[j] = guide[int_u < tablength ? int_u : tablength - 1];
+    }
+
+    /* Advance all lanes in lockstep by the typical length of the search,
+     * without branches such that the loop is vectorized */
+    for (int step = 0; step < 2; step++) {
+      for (int j = 0; j < m; j++) {
+        idx[j] += (idx[j] < last) & (ends[idx[j]+1] < uk[j]);
+      }
+    }
+
+    /* Finish the few lanes with longer searches one by one */
+    for (int j = 0; j < m; j++) {
+      while (idx[j] < last && ends[idx[j]+1] < uk[j]) idx[j]++;
+    }
+
+    /* Evaluate the Hermite approximations in every lane */
+    for (int j = 0; j < m; j++) {
+      int i = idx[j];
+      float Fl = ends[i];
+      float Fr = ends[i+1];
+      const struct spline *iv = &inv[i];
+      double u_tilde = (uk[j] - Fl) / (Fr - Fl);
+      x[k + j] = anyrng_cubic(iv->a0, iv->a1, iv->a2, iv->a3, u_tilde);
+    }
+
+    if (density == NULL) continue;
+
+    /* Evaluate the pdf splines in the same intervals */
+    for (int j = 0; j < m; j++) {
+      int i = idx[j];
+      float Fl = ends[i];
+      float Fr = ends[i+1];
+      const struct spline *fv = &dens[i];
+      double u_tilde = (uk[j] - Fl) / (Fr - Fl);
+      density[k + j] = anyrng_cubic(fv->a0, fv->a1, fv->a2, fv->a3, u_tilde);
+    }
+  }
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ANYRNG_MULTIVERSION
+#endif
+
+/* Portable kernel, compiled for the baseline instruction set */
+static inline void anyrng_batch_scalar(const double *u, double *x,
+                                      double *density, int n) {
+  anyrng_batch_kernel(u, x, density, n);
+}
+
+#ifdef ANYRNG_MULTIVERSION
+/* Kernel for processors with AVX2 and FMA */
+__attribute__((target("avx2,fma")))
+static inline void anyrng_batch_avx2(const double *u, double *x,
+                                    double *density, int n) {
+  anyrng_batch_kernel(u, x, density, n);
+}
+
+/* Kernel for processors with AVX-512 */
+__attribute__((target("avx512f,avx512vl,avx2,fma")))
+static inline void anyrng_batch_avx512(const double *u, double *x,
+                                      double *density, int n) {
+  anyrng_batch_kernel(u, x, density, n);
+}
+#endif
+
+/* Select the kernel for the instruction set of the running processor */
+static inline void anyrng_batch_dispatch(const double *u, double *x,
+                                         double *density, int n) {
+#ifdef ANYRNG_MULTIVERSION
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl")) {
+    anyrng_batch_avx512(u, x, density, n);
+    return;
+  } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    anyrng_batch_avx2(u, x, density, n);
+    return;
+  }
+#endif
+  anyrng_batch_scalar(u, x, density, n);
+}
+
+/**
+* @brief Transform an array of uniform random numbers into custom variates,
+* using the fastest kernel supported by the processor
+*
+* @param u Array of random numbers to be transformed
+* @param x Output array of custom variates
+* @param n Number of random numbers
+*/
+static inline void transform_variate_batch(const double *u, double *x, int n) {
+  anyrng_batch_dispatch(u, x, NULL, n);
+}
+
+/**
+* @brief Transform an array of uniform random numbers into custom variates
+* and evaluate the probability density at each variate
+*
+* @param u Array of random numbers to be transformed
+* @param x Output array of custom variates
+* @param density Output array of densities
+* @param n Number of random numbers
+*/
+static inline void transform_variate_and_density_batch(const double *u, double *x,
+                                                       double *density, int n) {
+  anyrng_batch_dispatch(u, x, density, n);
+}
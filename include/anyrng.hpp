@@ -0,0 +1,451 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+
+#ifndef ANYRNG_HPP
+#define ANYRNG_HPP
+
+/* Header-only C++ front end, which requires C++17. The pdf is passed as a
+ * functor or lambda, which is inlined into the construction loops. The tables
+ * use the same layout as the C API and can be exported to a struct sampler. */
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "random.h"
+
+namespace anyrng {
+
+/* The xoshiro256** generator of the C API as a uniform random bit generator,
+ * so that it can be used with the draw methods and with <random> */
+class Xoshiro256ss {
+ public:
+  using result_type = uint64_t;
+
+  explicit Xoshiro256ss(uint64_t seed) : state(rand_uint64_init(seed)) {}
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return UINT64_MAX; }
+  result_type operator()() { return rand_uint64(&state); }
+
+  /* Advance by 2^128 steps, for independent parallel streams */
+  void jump() { rand_uint64_jump(&state); }
+
+  rng_state state;
+};
+
+/**
+ * @brief Convert the output of a uniform random bit generator into a uniform
+ * random number on the open unit interval
+ *
+ * For 64-bit generators, this is the same as sampleUniform().
+ */
+template <class URBG>
+inline double uniform_open(URBG &g) {
+  using T = typename URBG::result_type;
+  const double range = static_cast<double>(T(URBG::max() - URBG::min())) + 1.0;
+  return (static_cast<double>(T(g() - URBG::min())) + 0.5) / range;
+}
+
+/**
+ * @brief A numerical inversion sampler for the pdf given by a functor
+ *
+ * @tparam Pdf Callable with signature double(double), need not be normalized
+ * @tparam Real Storage and evaluation type of the tables, float or double
+ * @tparam Order Order of the interpolation of the quantile function: 3 for
+ * cubic Hermite (as in the C API) or 1 for linear interpolation
+ */
+template <class Pdf, class Real = double, int Order = 3>
+class Sampler {
+  static_assert(Order == 1 || Order == 3, "Order must be 1 or 3");
+  static_assert(std::is_floating_point<Real>::value,
+                "Real must be a floating point type");
+
+ public:
+  using result_type = Real;
+
+  /**
+   * @brief Build the tables
+   *
+   * @param f The pdf
+   * @param xl Left endpoint of the domain
+   * @param xr Right endpoint of the domain
+   * @param tol Tolerance for the interpolation of the quantile function
+   *
+   * Float tables are checked after rounding, and the tolerance of the
+   * construction is tightened until they meet the requested tolerance, as in
+   * init_sampler_float().
+   */
+  Sampler(Pdf f, double xl, double xr, double tol)
+      : f_(f), xl_(xl), xr_(xr), tol_(tol) {
+    if constexpr (std::is_same<Real, float>::value) {
+      const double min_tol = 4 * std::numeric_limits<float>::epsilon();
+      double build_tol = 0.5 * tol;
+      while (build(build_tol) > tol) {
+        if (tol < min_tol || build_tol < min_tol) {
+          accurate_ = false;
+          break;
+        }
+        build_tol *= 0.25;
+      }
+    } else {
+      build(tol);
+    }
+  }
+
+  /* Transform a uniform random number into a variate X = F^-1(u) */
+  Real invert(Real u) const {
+    const int tablength = SEARCH_TABLE_LENGTH;
+    int int_u = static_cast<int>(u * tablength);
+    int i = index_[int_u < tablength ? int_u : tablength - 1];
+
+    /* Find the interval such that F(l) <= u <= F(r) */
+    const int n = intervals();
+    while (i < n - 1 && F_[i + 1] < u) i++;
+
+    const Real *a = &coeffs_[(Order + 1) * i];
+    Real u_tilde = (u - F_[i]) / (F_[i + 1] - F_[i]);
+    if constexpr (Order == 1) {
+#ifdef ANYRNG_DETERMINISTIC
+      return std::fma(u_tilde, a[1], a[0]);
+#else
+      return a[0] + a[1] * u_tilde;
+#endif
+    } else if constexpr (std::is_same<Real, float>::value) {
+      return hermite_cubicf(a[0], a[1], a[2], a[3], u_tilde);
+    } else {
+      /* The same evaluation as draw_sampler(), see hermite_cubic */
+      return static_cast<Real>(hermite_cubic(a[0], a[1], a[2], a[3], u_tilde));
+    }
+  }
+
+  /* Draw one variate with a uniform random bit generator */
+  template <class URBG>
+  Real operator()(URBG &g) const {
+    return invert(static_cast<Real>(uniform_open(g)));
+  }
+
+  /* Fill the range [first, last) with variates */
+  template <class URBG, class OutputIt>
+  OutputIt generate(URBG &g, OutputIt first, OutputIt last) const {
+    for (; first != last; ++first) {
+      *first = (*this)(g);
+    }
+    return first;
+  }
+
+  /* Fill a range, e.g. a std::vector or std::span, with variates */
+  template <class URBG, class Range>
+  void fill(URBG &g, Range &&range) const {
+    generate(g, std::begin(range), std::end(range));
+  }
+
+  /* Transform a range of uniform random numbers into variates */
+  template <class InputIt, class OutputIt>
+  OutputIt transform(InputIt first, InputIt last, OutputIt out) const {
+    for (; first != last; ++first, ++out) {
+      *out = invert(static_cast<Real>(*first));
+    }
+    return out;
+  }
+
+  int intervals() const { return static_cast<int>(F_.size()) - 1; }
+  double xl() const { return xl_; }
+  double xr() const { return xr_; }
+  double tol() const { return tol_; }
+
+  /* False if the tolerance could not be met everywhere, in which case
+   * init_sampler() or init_sampler_float() would return 1 */
+  bool accurate() const { return accurate_; }
+
+  /**
+   * @brief Copy the tables into a C sampler, which can then be used with the
+   * functions of the C API and must be freed with clean_sampler()
+   *
+   * The pdf is not available from C, so draw_pdf() and refinement are not
+   * supported for the exported sampler. The tables are generated here, so
+   * only the C functions that use them need the library.
+   */
+  void export_sampler(struct sampler *s) const {
+    const int n = intervals();
+    std::memset(s, 0, sizeof(struct sampler));
+    s->norm = norm_;
+    s->xl = xl_;
+    s->xr = xr_;
+    s->tol = tol_;
+    s->intervalNum = n;
+    s->intervals =
+        static_cast<struct interval *>(std::malloc(n * sizeof(struct interval)));
+
+    for (int i = 0; i < n; i++) {
+      struct interval *iv = &s->intervals[i];
+      std::memset(iv, 0, sizeof(struct interval));
+      const Real *a = &coeffs_[(Order + 1) * i];
+      iv->l = l_[i];
+      iv->r = l_[i + 1];
+      iv->Fl = F_[i];
+      iv->Fr = F_[i + 1];
+      iv->a0 = a[0];
+      iv->a1 = a[1];
+      if constexpr (Order == 3) {
+        iv->a2 = a[2];
+        iv->a3 = a[3];
+      }
+    }
+
+    export_search_tables(s);
+  }
+
+  /**
+   * @brief Copy the tables of an initialized C sampler, keeping the given
+   * pdf for reference
+   *
+   * Only cubic samplers can be imported, since the C tables are cubic.
+   */
+  static Sampler import_sampler(Pdf f, const struct sampler *s) {
+    static_assert(Order == 3, "Only cubic tables can be imported");
+    Sampler out(f, s->xl, s->xr, s->tol, s->norm);
+    const int n = s->intervalNum;
+    out.F_.resize(n + 1);
+    out.l_.resize(n + 1);
+    out.coeffs_.resize((Order + 1) * n);
+    for (int i = 0; i < n; i++) {
+      const struct interval *iv = &s->intervals[i];
+      out.F_[i] = static_cast<Real>(iv->Fl);
+      out.l_[i] = iv->l;
+      Real *a = &out.coeffs_[(Order + 1) * i];
+      a[0] = static_cast<Real>(iv->a0);
+      a[1] = static_cast<Real>(iv->a1);
+      a[2] = static_cast<Real>(iv->a2);
+      a[3] = static_cast<Real>(iv->a3);
+    }
+    out.F_[n] = 1;
+    out.l_[n] = s->xr;
+    out.build_index();
+    return out;
+  }
+
+ private:
+  /* An interval that is still being refined */
+  struct Pending {
+    double l, r, Fl, Fr;
+  };
+
+  Sampler(Pdf f, double xl, double xr, double tol, double norm)
+      : f_(f), xl_(xl), xr_(xr), tol_(tol), norm_(norm) {}
+
+  /* Link the exported intervals and generate the search tables in the same
+   * way as build_search_table(), for intervals that are already sorted */
+  static void export_search_tables(struct sampler *s) {
+    const int n = s->intervalNum;
+    for (int i = 0; i < n; i++) {
+      s->intervals[i].id = i;
+      s->intervals[i].nid = (i < n - 1) ? i + 1 : -1;
+    }
+
+    /* The last interval such that u > F(r), or the first one if none */
+    s->index =
+        static_cast<double *>(std::malloc(SEARCH_TABLE_LENGTH * sizeof(double)));
+    int i = 0;
+    for (int k = 0; k < SEARCH_TABLE_LENGTH; k++) {
+      double u = static_cast<double>(k) / SEARCH_TABLE_LENGTH;
+      while (i < n - 1 && s->intervals[i + 1].Fr < u) i++;
+      s->index[k] = i;
+    }
+
+    /* The last interval such that l <= x at the start of each bin */
+    s->xindex = static_cast<int *>(std::malloc(SEARCH_TABLE_LENGTH * sizeof(int)));
+    i = 0;
+    for (int k = 0; k < SEARCH_TABLE_LENGTH; k++) {
+      double x = s->xl + (s->xr - s->xl) * k / SEARCH_TABLE_LENGTH;
+      while (i < n - 1 && s->intervals[i + 1].l <= x) i++;
+      s->xindex[k] = i;
+    }
+  }
+
+  /* Midpoint rule integration of the pdf, as numerical_cdf() */
+  double integral(double a, double b) const {
+    double out = 0.0;
+    double delta = (b - a) / NUMERICAL_CDF_SAMPLES;
+    for (int i = 0; i < NUMERICAL_CDF_SAMPLES; i++) {
+      out += f_(a + (i + 0.5) * delta);
+    }
+    return out * delta;
+  }
+
+  /* Fit the interpolant in an interval and return the error at the midpoint
+   * of [Fl, Fr], or infinity if the interpolant is not monotonic */
+  double fit(const Pending &p, double *a) const {
+    double dF = p.Fr - p.Fl;
+    double H;
+    char monotonic = 1;
+
+    if constexpr (Order == 1) {
+      a[0] = p.l;
+      a[1] = p.r - p.l;
+      H = a[0] + 0.5 * a[1];
+    } else {
+      double fl = norm_ * f_(p.l);
+      double fr = norm_ * f_(p.r);
+      a[0] = p.l;
+      a[1] = dF / fl;
+      a[2] = 3 * (p.r - p.l) - dF * (2. / fl + 1. / fr);
+      a[3] = 2 * (p.l - p.r) + dF * (1. / fl + 1. / fr);
+      H = a[0] + a[1] * 0.5 + a[2] * 0.25 + a[3] * 0.125;
+
+      double delta = dF / (p.r - p.l);
+      monotonic = (delta <= 3 * fl) && (delta <= 3 * fr);
+    }
+
+    /* Integrate from the left endpoint, which is more accurate and cheaper
+     * than integrating from the left end of the domain */
+    double error = std::fabs(norm_ * integral(p.l, H) - 0.5 * dF);
+    return monotonic ? error : std::numeric_limits<double>::infinity();
+  }
+
+  /* Build the tables with the given tolerance. For float tables, returns the
+   * largest error of the rounded tables, and 0 otherwise. */
+  double build(double build_tol) {
+    l_.clear();
+    F_.clear();
+    coeffs_.clear();
+    accurate_ = true;
+
+    /* Approximate normalization of the pdf, corrected at the end */
+    norm_ = 1.0 / integral(xl_, xr_);
+
+    /* Refine intervals depth-first from left to right, so that the accepted
+     * intervals come out sorted. The cdf is accumulated over the accepted
+     * intervals only, which keeps it monotonic. */
+    std::vector<std::pair<double, double>> stack;
+    std::vector<double> F;
+    stack.push_back({xl_, xr_});
+    double F_left = 0.;
+    while (!stack.empty()) {
+      double l = stack.back().first;
+      double r = stack.back().second;
+      stack.pop_back();
+
+      Pending p = {l, r, F_left, F_left + norm_ * integral(l, r)};
+      double a[4] = {0., 0., 0., 0.};
+      double m = l + 0.5 * (r - l);
+      char splittable = (m > l && m < r);
+
+      /* Intervals may cover at most 5% of the probability */
+      char split = (p.Fr - p.Fl > 0.05) || fit(p, a) > build_tol;
+      if (split && splittable) {
+        stack.push_back({m, r});
+        stack.push_back({l, m});
+        continue;
+      } else if (split) {
+        accurate_ = false;
+      }
+
+      l_.push_back(l);
+      F.push_back(p.Fl);
+      for (int k = 0; k <= Order; k++) {
+        coeffs_.push_back(static_cast<Real>(a[k]));
+      }
+      F_left = p.Fr;
+    }
+    l_.push_back(xr_);
+
+    /* Renormalize with the accumulated total. This does not change the
+     * interpolation coefficients, which only depend on ratios of F and f. */
+    norm_ /= F_left;
+    for (double &Fl : F) {
+      Fl /= F_left;
+      F_.push_back(static_cast<Real>(Fl));
+    }
+    F_.push_back(1);
+
+    build_index();
+
+    if constexpr (std::is_same<Real, float>::value) {
+      return rounding_error(F);
+    } else {
+      return 0.;
+    }
+  }
+
+  /* Largest error of the rounded tables at the quarter points of every
+   * interval, as checked by init_sampler_float(). F is the cdf at the left
+   * endpoints before rounding. */
+  double rounding_error(const std::vector<double> &F) const {
+    double max_error = 0.;
+    for (int i = 0; i < intervals(); i++) {
+      /* Intervals that collapse after rounding are never selected */
+      if (!(F_[i + 1] > F_[i])) continue;
+
+      for (int j = 1; j < 4; j++) {
+        Real u = F_[i] + static_cast<Real>(0.25 * j) * (F_[i + 1] - F_[i]);
+        double x = invert(u);
+        double error = std::fabs(F[i] + norm_ * integral(l_[i], x) - u);
+        if (!(error <= max_error)) max_error = error;
+      }
+    }
+    return max_error;
+  }
+
+  /* The search table: the first interval whose right endpoint has a cdf of
+   * at least k / SEARCH_TABLE_LENGTH */
+  void build_index() {
+    const int n = intervals();
+    int i = 0;
+    for (int k = 0; k < SEARCH_TABLE_LENGTH; k++) {
+      Real u = static_cast<Real>(k) / SEARCH_TABLE_LENGTH;
+      while (i < n - 1 && F_[i + 1] < u) i++;
+      index_[k] = i;
+    }
+  }
+
+  Pdf f_;
+  double xl_, xr_, tol_;
+  double norm_ = 1.;
+  bool accurate_ = true;
+
+  /* The cdf at the left endpoints, with one extra entry F = 1 at the end */
+  std::vector<Real> F_;
+
+  /* The left endpoints, with one extra entry for the right end */
+  std::vector<double> l_;
+
+  /* The interpolation coefficients, Order + 1 per interval */
+  std::vector<Real> coeffs_;
+
+  int index_[SEARCH_TABLE_LENGTH];
+};
+
+/* Build a sampler for a lambda, choosing the storage type and order */
+template <class Real = double, int Order = 3, class Pdf>
+Sampler<Pdf, Real, Order> make_sampler(Pdf f, double xl, double xr,
+                                       double tol) {
+  return Sampler<Pdf, Real, Order>(f, xl, xr, tol);
+}
+
+}  // namespace anyrng
+
+#endif
@@ -0,0 +1,87 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "../include/random.h"
+
+#ifdef WITH_MPI
+#include <mpi.h>
+#endif
+
+/* Abstraction of the communication between processes that build a sampler
+ * together */
+struct build_transport {
+  /*! Rank of this process and the number of processes */
+  int rank, size;
+
+  /*! Gather a block of bytes from every process on every process. The
+   *  blocks are concatenated in order of rank into a newly allocated buffer.
+   *  Returns 0 on success. */
+  int (*allgatherv)(struct build_transport *t, const void *send, size_t bytes,
+                    void **recv, size_t *recv_bytes);
+
+  /*! Implementation specific data */
+  void *ctx;
+};
+
+/* Shared memory segment used by the local multi-process transport */
+struct shm_segment {
+  pthread_barrier_t barrier;
+
+  /*! Number of bytes available for the blocks of all processes together */
+  size_t capacity;
+
+  /*! Number of bytes sent by every process in the current exchange */
+  size_t bytes[];
+};
+
+/* Local implementation of the transport, with processes forked from a single
+ * parent that communicate through POSIX shared memory */
+struct shm_transport {
+  struct build_transport base;
+
+  /*! The mapped shared memory segment and its total size */
+  struct shm_segment *segment;
+  size_t mapped;
+
+  /*! Process ids of the children, only known to the parent */
+  pid_t *children;
+};
+
+/* Distributed construction of a sampler */
+int init_sampler_distributed(struct sampler *s, struct build_transport *t,
+                             pdf f, pdf df, double xl, double xr, double tol,
+                             void *params);
+
+/* Methods for the local shared memory transport */
+int shm_transport_create(struct shm_transport *t, int size, size_t capacity);
+int shm_transport_fork(struct shm_transport *t);
+void shm_transport_destroy(struct shm_transport *t);
+
+#ifdef WITH_MPI
+void mpi_transport_init(struct build_transport *t, MPI_Comm *comm);
+#endif
+
+#endif
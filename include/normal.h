@@ -0,0 +1,90 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef NORMAL_H
+#define NORMAL_H
+
+#include <stddef.h>
+#include <math.h>
+
+#include "../include/random_xorshift.h"
+
+#define ZIGGURAT_LAYERS 256
+
+/* Tables for the ziggurat method of Marsaglia & Tsang (2000), in the form
+ * given by Doornik (2005) */
+struct ziggurat {
+  /*! Right edges of the layers, x[0] = v / f(r), x[1] = r, x[256] = 0 */
+  double x[ZIGGURAT_LAYERS + 1];
+
+  /*! Ratios x[i+1] / x[i], below which a point is accepted immediately */
+  double ratio[ZIGGURAT_LAYERS];
+
+  /*! The unnormalized Gaussian exp(-x^2/2) evaluated at the edges */
+  double fx[ZIGGURAT_LAYERS + 1];
+};
+
+/* Cache for the second Gaussian produced by the Box-Mueller transform */
+struct normal_cache {
+  double z;
+  char full;
+};
+
+/* Methods for generating standard normal variates */
+double sampleNorm(rng_state *state);
+void sampleNormPair(rng_state *state, double *z0, double *z1);
+void init_ziggurat(struct ziggurat *z);
+double ziggurat_slow(const struct ziggurat *z, rng_state *state, int i,
+                     double x);
+void fillNorm(const struct ziggurat *z, rng_state *state, double *out,
+              size_t n);
+
+/* Generate a standard normal variable with Box-Mueller, caching the second
+ * variable for the next call */
+static inline double sampleNormCached(rng_state *state,
+                                      struct normal_cache *cache) {
+  if (cache->full) {
+    cache->full = 0;
+    return cache->z;
+  }
+
+  double z0;
+  sampleNormPair(state, &z0, &cache->z);
+  cache->full = 1;
+  return z0;
+}
+
+/* Generate a standard normal variable with the ziggurat method. A single 64-bit
+ * random integer suffices in about 99% of cases. */
+static inline double sampleNormZiggurat(const struct ziggurat *z,
+                                        rng_state *state) {
+  const uint64_t A = rand_uint64(state);
+  const int i = A & (ZIGGURAT_LAYERS - 1);
+
+  /* Uniform variable on [-1, 1) from the upper 53 bits */
+  const double u = (double)((int64_t)A >> 11) * 0x1p-52;
+  const double x = u * z->x[i];
+
+  /* Accept points in the rectangular part of the layer */
+  if (fabs(u) < z->ratio[i]) return x;
+
+  return ziggurat_slow(z, state, i, x);
+}
+
+#endif
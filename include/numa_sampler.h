@@ -0,0 +1,46 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef NUMA_SAMPLER_H
+#define NUMA_SAMPLER_H
+
+#include "../include/random.h"
+
+/* Read-only copies of the tables of a sampler, one on each NUMA node */
+struct numa_sampler {
+  /*! One copy of the sampler per node, allocated on that node */
+  struct sampler *replicas;
+
+  /*! The number of NUMA nodes */
+  int nodeNum;
+
+  /*! The node of each cpu, or -1 for cpus that are not online */
+  int *cpu_node;
+  int cpuNum;
+};
+
+/* Methods for NUMA-aware sampling */
+int init_numa_sampler(struct numa_sampler *ns, struct sampler *s);
+void clean_numa_sampler(struct numa_sampler *ns);
+struct sampler *numa_sampler_local(struct numa_sampler *ns);
+int numa_sampler_bind(struct numa_sampler *ns, int node, int k);
+void draw_numa_sampler_batch(struct numa_sampler *ns, const double *u,
+                             double *x, long n);
+
+#endif
@@ -0,0 +1,92 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef PDF_RUNTIME_H
+#define PDF_RUNTIME_H
+
+#include <stddef.h>
+
+#include "../include/random.h"
+
+#define EXPR_MAX_PARAMS 16
+#define EXPR_MAX_STACK 32
+#define EXPR_BATCH_LENGTH 256
+
+/* Instructions of the stack machine that evaluates pdf expressions */
+enum expr_opcode {
+  EXPR_X, EXPR_PARAM, EXPR_CONST,
+  EXPR_ADD, EXPR_SUB, EXPR_MUL, EXPR_DIV, EXPR_POW, EXPR_NEG,
+  EXPR_LT, EXPR_LE, EXPR_GT, EXPR_GE, EXPR_MIN, EXPR_MAX, EXPR_SELECT,
+  EXPR_EXP, EXPR_LOG, EXPR_SQRT, EXPR_SIN, EXPR_COS, EXPR_ABS
+};
+
+struct expr_instr {
+  enum expr_opcode op;
+  int arg;       // parameter index
+  double value;  // constant value
+};
+
+/* A pdf given as an expression in x and parameters p0, p1, ..., compiled
+ * to bytecode for a vectorized stack machine */
+struct pdf_expression {
+  /*! The compiled bytecode */
+  struct expr_instr *code;
+  int codeNum;
+
+  /*! The maximum depth of the stack */
+  int stackSize;
+
+  /*! The parameters p0, p1, ... */
+  double params[EXPR_MAX_PARAMS];
+  int paramNum;
+
+  /*! Description of the first compilation error */
+  char error[128];
+};
+
+/* A pdf loaded at runtime from a shared object */
+struct pdf_plugin {
+  /*! Handle returned by dlopen */
+  void *handle;
+
+  /*! The pdf and its optional derivative */
+  pdf f;
+  pdf df;
+
+  /*! Optional batch version of the pdf, found as <symbol>_batch */
+  pdf_batch fb;
+
+  /*! Description of the error if the plugin could not be loaded */
+  char error[256];
+};
+
+/* Methods for pdfs given as expressions */
+int compile_pdf_expression(struct pdf_expression *e, const char *source,
+                           const double *params, int paramNum);
+void clean_pdf_expression(struct pdf_expression *e);
+double eval_pdf_expression(double x, void *params);
+void eval_pdf_expression_batch(const double *x, double *out, size_t n,
+                               void *params);
+
+/* Methods for pdfs loaded from shared objects */
+int load_pdf_plugin(struct pdf_plugin *p, const char *path,
+                    const char *symbol, const char *dsymbol);
+void close_pdf_plugin(struct pdf_plugin *p);
+
+#endif
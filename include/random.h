@@ -22,13 +22,25 @@
 
 /* We use the xoshiro256** pseudo-random number generator */
 #include "../include/random_xorshift.h"
+#include <stddef.h>
+#include <math.h>
+#ifndef __cplusplus
+#include <stdatomic.h>
+#endif
 
 #define SEARCH_TABLE_LENGTH 100
 #define NUMERICAL_CDF_SAMPLES 1000
 
+/* Upper limit on the number of intervals created by the refinement */
+#define MAX_INTERVAL_NUM (1 << 20)
+
 /* We allow for arbitrary probability density functions */
 typedef double (*pdf)(double x, void *params);
 
+/* Optionally, the pdf can be evaluated for many points at once */
+typedef void (*pdf_batch)(const double *x, double *out, size_t n,
+                          void *params);
+
 /* A numerical inversion sampler that can be used for arbitrary distributions */
 struct sampler {
   /*! The normalization of the pdf */
@@ -46,6 +58,12 @@ struct sampler {
   /*! Optional pointer to derivative of the pdf */
   pdf df;
 
+  /*! Optional pointer to a batch version of the pdf */
+  pdf_batch fb;
+
+  /*! Optional pointer to the exact (unnormalized) cdf */
+  pdf cdf;
+
   /*! Tolerance for the Hermite interpolation */
   double tol;
 
@@ -60,6 +78,31 @@ struct sampler {
 
   /*! The indexed search table */
   double *index;
+
+  /*! The indexed search table for the inverse lookup x -> F(x) */
+  int *xindex;
+
+  /*! Block holding all tables if moved into huge pages, otherwise NULL */
+  void *table_memory;
+
+  /*! Size of the block if mapped with explicit huge pages, otherwise 0 */
+  size_t table_mapped;
+};
+
+/* A sub-range [a, b] of the domain of a sampler, with the cdf evaluated at
+ * its endpoints */
+struct sampler_truncation {
+  /*! The left endpoint, clamped to the domain */
+  double a;
+
+  /*! The right endpoint, clamped to the domain */
+  double b;
+
+  /*! The cdf at the left endpoint */
+  double Fa;
+
+  /*! The cdf at the right endpoint */
+  double Fb;
 };
 
 /* Intervals used by the numerical inversion sampler */
@@ -69,24 +112,112 @@ struct interval {
   double Fl, Fr;          // cdf evaluations at endpoints
   double a0, a1, a2, a3;  // cubic Hermite coefficients
   double b0, b1, b2, b3;  // cubic Hermite coefficients for the pdf
-  int nid;                // the next interval
+  double error;           // estimated error, negative if not yet fitted
+  int nid;                // the next interval, negative for the last
 };
 
-/* Compare intervals by the value of the CDF at the left endpoint */
+/* Compare intervals by the value of the CDF at the left endpoint, and by the
+ * left endpoint for intervals in tails where the CDF is rounded to 0 or 1 */
 static inline int compareByLeft(const void *a, const void *b) {
   struct interval *ia = (struct interval *)a;
   struct interval *ib = (struct interval *)b;
-  return ia->Fl >= ib->Fl;
+  if (ia->Fl != ib->Fl) return (ia->Fl > ib->Fl) - (ia->Fl < ib->Fl);
+  return (ia->l > ib->l) - (ia->l < ib->l);
+}
+
+/* Evaluate the cubic a0 + a1 * t + a2 * t^2 + a3 * t^3 of a Hermite
+ * interpolant. If ANYRNG_DETERMINISTIC is defined, Horner's scheme is used
+ * with explicit fused multiply-adds, which are rounded once on any machine,
+ * such that all code paths give bitwise identical results independent of the
+ * instruction set and of the contractions chosen by the compiler. */
+static inline double hermite_cubic(double a0, double a1, double a2, double a3,
+                                   double t) {
+#ifdef ANYRNG_DETERMINISTIC
+  return fma(t, fma(t, fma(t, a3, a2), a1), a0);
+#else
+  return a0 + a1 * t + a2 * t * t + a3 * t * t * t;
+#endif
 }
 
+/* Single-precision version of hermite_cubic, using Horner's scheme */
+static inline float hermite_cubicf(float a0, float a1, float a2, float a3,
+                                   float t) {
+#ifdef ANYRNG_DETERMINISTIC
+  return fmaf(t, fmaf(t, fmaf(t, a3, a2), a1), a0);
+#else
+  return a0 + t * (a1 + t * (a2 + t * a3));
+#endif
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /* Methods that allow one to sample from arbitrary distribution */
-void init_sampler(struct sampler *s, pdf f, pdf df, double xl, double xr,
-                  double tol, void *params);
-void split_interval(struct sampler *s, int current_interval_id);
+int init_sampler(struct sampler *s, pdf f, pdf df, double xl, double xr,
+                 double tol, void *params);
+int init_sampler_batch(struct sampler *s, pdf f, pdf_batch fb, pdf df,
+                       double xl, double xr, double tol, void *params);
+void prepare_sampler(struct sampler *s, pdf f, pdf_batch fb, pdf df,
+                     double xl, double xr, double tol, void *params);
+int init_sampler_cdf(struct sampler *s, pdf f, pdf cdf, pdf df, double xl,
+                     double xr, double tol, void *params);
+int split_interval(struct sampler *s, int current_interval_id);
+int refine_intervals(struct sampler *s, int first_interval_id, double tol);
+void build_search_table(struct sampler *s);
 void clean_sampler(struct sampler *s);
+void copy_sampler(struct sampler *dst, const struct sampler *src);
+int sampler_use_hugepages(struct sampler *s);
+int refine_sampler(struct sampler *s, double tol);
+int coarsen_sampler(struct sampler *s, double tol);
 double draw_sampler(struct sampler *s, double u);
 double draw_pdf(struct sampler *s, double u);
+void draw_sampler_batch(struct sampler *s, const double *u, double *x, int n);
+void draw_sampler_sorted_batch(struct sampler *s, const double *u, double *x,
+                               int n);
+void draw_sampler_sorted(struct sampler *s, rng_state *state, double *x,
+                         int n);
+void draw_sampler_stratified(struct sampler *s, rng_state *state, double *x,
+                             int n);
+double sampler_cdf(struct sampler *s, double x);
+double sampler_pdf(struct sampler *s, double x);
+void sampler_cdf_batch(struct sampler *s, const double *x, double *F, int n);
+void sampler_pdf_batch(struct sampler *s, const double *x, double *f, int n);
+double draw_sampler_truncated(struct sampler *s, double a, double b, double u);
+void draw_sampler_truncated_batch(struct sampler *s, double a, double b,
+                                  const double *u, double *x, int n);
+int init_sampler_truncation(struct sampler *s, struct sampler_truncation *t,
+                            double a, double b);
+double draw_sampler_truncation(struct sampler *s,
+                               const struct sampler_truncation *t, double u);
+void draw_sampler_truncation_batch(struct sampler *s,
+                                   const struct sampler_truncation *t,
+                                   const double *u, double *x, int n);
+double numerical_cdf(double xl, double xr, pdf f, void *params);
+double numerical_cdf_batch(double xl, double xr, pdf_batch fb, void *params);
+
+#ifdef __cplusplus
+}
+#endif
 
+#ifndef __cplusplus
+/* A sampler whose tables can be replaced while other threads are sampling */
+struct live_sampler {
+  _Atomic(struct sampler *) current;
+};
 
+/* Get the current tables. Load once per batch of draws and use the same
+ * pointer for the whole batch. */
+static inline struct sampler *live_sampler_get(struct live_sampler *ls) {
+  return atomic_load_explicit(&ls->current, memory_order_acquire);
+}
+
+/* Publish new tables and return the old ones. The old tables can be cleaned
+ * once all threads that loaded them have finished their batches. */
+static inline struct sampler *live_sampler_swap(struct live_sampler *ls,
+                                                struct sampler *s) {
+  return atomic_exchange_explicit(&ls->current, s, memory_order_acq_rel);
+}
+#endif
 
 #endif
@@ -1,5 +1,8 @@
 /*  Adapted from the code included on Sebastian Vigna's website */
 
+#ifndef RANDOM_XORSHIFT_H
+#define RANDOM_XORSHIFT_H
+
 #include <stdint.h>
 
 #define XOR_RAND_MAX UINT64_MAX
@@ -58,6 +61,29 @@ static inline struct xoshiro256ss_state xoshiro256ss_init(uint64_t seed) {
     return result;
 };
 
+/* Advance the state by 2^128 steps, to obtain non-overlapping streams */
+
+static inline void xoshiro256ss_jump(struct xoshiro256ss_state *state) {
+    static const uint64_t JUMP[] = {0x180ec6d33cfd0aba, 0xd5a61266f0c9392c,
+                                    0xa9582618e03fc9aa, 0x39abdc4529b1661c};
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (int i = 0; i < 4; i++) {
+        for (int b = 0; b < 64; b++) {
+            if (JUMP[i] & UINT64_C(1) << b) {
+                s0 ^= state->s[0];
+                s1 ^= state->s[1];
+                s2 ^= state->s[2];
+                s3 ^= state->s[3];
+            }
+            xoshiro256ss(state);
+        }
+    }
+    state->s[0] = s0;
+    state->s[1] = s1;
+    state->s[2] = s2;
+    state->s[3] = s3;
+}
+
 /* Define some aliases */
 typedef struct xoshiro256ss_state rng_state;
 static inline uint64_t rand_uint64(rng_state *state) {
@@ -66,9 +92,40 @@ static inline uint64_t rand_uint64(rng_state *state) {
 static inline rng_state rand_uint64_init(uint64_t seed) {
     return xoshiro256ss_init(seed);
 }
+static inline void rand_uint64_jump(rng_state *state) {
+    xoshiro256ss_jump(state);
+}
 /* Generate a uniform variable on the open unit interval */
 static inline double sampleUniform(rng_state *state) {
     const uint64_t A = rand_uint64(state);
     const double RM = (double) UINT64_MAX + 1;
     return ((double) A + 0.5) / RM;
 }
+
+/* Generate a single-precision uniform variable on the open unit interval.
+ * We keep 23 bits, so that (A + 0.5) is exactly representable as a float. */
+static inline float sampleUniformf(rng_state *state) {
+    const uint64_t A = rand_uint64(state) >> 41;
+    return ((float) A + 0.5f) * 0x1p-23f;
+}
+
+/* Generate two single-precision uniform variables on the open unit interval,
+ * one from each 32-bit half of a single 64-bit random integer */
+static inline void sampleUniformf2(rng_state *state, float *u0, float *u1) {
+    const uint64_t A = rand_uint64(state);
+    *u0 = ((float) (A >> 41) + 0.5f) * 0x1p-23f;
+    *u1 = ((float) ((A >> 9) & 0x7FFFFF) + 0.5f) * 0x1p-23f;
+}
+
+/* Fill an array with single-precision uniform variables */
+static inline void fillUniformf(rng_state *state, float *u, int n) {
+    int i;
+    for (i = 0; i + 1 < n; i += 2) {
+        sampleUniformf2(state, &u[i], &u[i + 1]);
+    }
+    if (i < n) {
+        u[i] = sampleUniformf(state);
+    }
+}
+
+#endif
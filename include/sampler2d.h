@@ -0,0 +1,75 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+
+#ifndef SAMPLER2D_H
+#define SAMPLER2D_H
+
+#include "../include/random.h"
+#include "../include/tabulated.h"
+
+/* Number of grid points on which the marginal and conditional pdfs are
+ * tabulated */
+#define SAMPLER2D_TABLE_POINTS 1025
+
+/* Initial and maximum number of conditional tables */
+#define SAMPLER2D_INITIAL_GRID 9
+#define SAMPLER2D_MAX_GRID 4097
+
+/* Number of quantiles at which the interpolation between conditional tables
+ * is checked */
+#define SAMPLER2D_PROBES 8
+
+/* A joint probability density function f(x, y) */
+typedef double (*pdf2d)(double x, double y, void *params);
+
+/* A sampler for a joint distribution of two variables, using a table for the
+ * marginal distribution of x and tables for the conditional distribution of
+ * y on a grid of x values */
+struct sampler2d {
+  /*! The joint pdf and its parameters */
+  pdf2d f;
+  void *params;
+
+  /*! The domain [xl, xr] x [yl, yr] */
+  double xl, xr, yl, yr;
+
+  /*! The tables for the marginal distribution of x */
+  struct sampler marginal;
+
+  /*! The grid of x values, in increasing order */
+  double *grid;
+
+  /*! The tables for the conditional distributions of y at the grid points */
+  struct sampler *conditionals;
+
+  /*! The number of grid points */
+  int gridNum;
+};
+
+/* Methods for sampling from joint distributions */
+int init_sampler2d(struct sampler2d *s2, pdf2d f, double xl, double xr,
+                   double yl, double yr, double tol, void *params);
+void clean_sampler2d(struct sampler2d *s2);
+void draw_sampler2d(struct sampler2d *s2, double u, double v, double *x,
+                    double *y);
+void draw_sampler2d_batch(struct sampler2d *s2, const double *u,
+                          const double *v, double *x, double *y, int n);
+
+#endif
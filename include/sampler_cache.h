@@ -0,0 +1,80 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef SAMPLER_CACHE_H
+#define SAMPLER_CACHE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../include/random.h"
+
+/* A cached sampler, together with the key used to look it up */
+struct cache_entry {
+  /*! Hash of the pdf identity, parameters, domain and tolerance */
+  uint64_t hash;
+
+  /*! Name identifying the pdf, or NULL if identified by function pointer */
+  char *name;
+
+  /*! The pdf and its derivative, used to identify unnamed pdfs */
+  pdf f, df;
+
+  /*! Copy of the parameter bytes passed to the pdf */
+  void *params;
+  size_t params_size;
+
+  /*! The cached tables */
+  struct sampler s;
+
+  /*! Time of last use, for least-recently-used eviction */
+  unsigned long last_use;
+};
+
+/* A least-recently-used cache of samplers with an optional directory of
+ * serialized tables on disk */
+struct sampler_cache {
+  /*! The cached samplers */
+  struct cache_entry *entries;
+
+  /*! The number of cached samplers and the maximum number */
+  int entryNum;
+  int capacity;
+
+  /*! Counter used to keep track of the order of use */
+  unsigned long clock;
+
+  /*! Optional directory for serialized tables, can be NULL */
+  char *dir;
+};
+
+/* Methods for caching samplers */
+void init_sampler_cache(struct sampler_cache *c, int capacity,
+                        const char *dir);
+void clean_sampler_cache(struct sampler_cache *c);
+int cached_init_sampler(struct sampler_cache *c, struct sampler *s,
+                        const char *name, pdf f, pdf df, double xl, double xr,
+                        double tol, void *params, size_t params_size);
+
+/* Methods for (de)serializing the tables of a sampler */
+int save_sampler(const struct sampler *s, FILE *f);
+int load_sampler(struct sampler *s, FILE *f);
+
+#endif
@@ -0,0 +1,131 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+
+#ifndef SAMPLER_COMPRESSED_H
+#define SAMPLER_COMPRESSED_H
+
+#include <stdint.h>
+
+#include "../include/random.h"
+
+/* Number of consecutive intervals that share one set of scale factors */
+#define COMPRESSED_BLOCK_SIZE 16
+
+/* An interval of the compressed tables, stored as 32-bit integers that are
+ * decoded with the scale factors of its block. More than three intervals fit
+ * in a cache line, compared to about half of one for the uncompressed
+ * #interval. */
+struct compressed_interval {
+  uint32_t F;           // cdf at the left endpoint, offset within the block
+  uint32_t a0;          // left endpoint, offset within the block
+  int32_t a1, a2, a3;   // Hermite coefficients
+};
+
+/* Scale factors shared by a block of intervals */
+struct compressed_block {
+  double F0, F_scale;  // F = F0 + F_scale * F_offset
+  double x0, x_scale;  // a0 = x0 + x_scale * a0_offset
+  double a1_scale, a2_scale, a3_scale;
+};
+
+/* A copy of the runtime tables of a numerical inversion sampler, encoded in
+ * fixed point such that large tables stay resident in cache */
+struct sampler_compressed {
+  /*! The encoded intervals, with one extra entry F = 1 at the end */
+  struct compressed_interval *intervals;
+
+  /*! The scale factors of each block of COMPRESSED_BLOCK_SIZE intervals */
+  struct compressed_block *blocks;
+
+  /*! The number of intervals */
+  int intervalNum;
+
+  /*! The indexed search table */
+  int *index;
+};
+
+/* Methods for sampling from compressed tables */
+int init_sampler_compressed(struct sampler_compressed *sc, pdf f, double xl,
+                            double xr, double tol, void *params);
+double compress_sampler(struct sampler_compressed *sc, struct sampler *s,
+                        double tol);
+void clean_sampler_compressed(struct sampler_compressed *sc);
+
+/**
+ * @brief Decode the cdf at the left endpoint of an interval
+ *
+ * @param sc The #sampler_compressed for the distribution
+ * @param i Index of the interval, up to and including intervalNum
+ */
+static inline double compressed_cdf(const struct sampler_compressed *sc,
+                                     int i) {
+  const struct compressed_block *b = &sc->blocks[i / COMPRESSED_BLOCK_SIZE];
+  return b->F0 + b->F_scale * sc->intervals[i].F;
+}
+
+/**
+ * @brief Transform a uniform random number into a custom variate X = F^-1(u),
+ * decoding the compressed tables on the fly
+ *
+ * @param sc The #sampler_compressed for the distribution
+ * @param u Random number to be transformed
+ */
+static inline double
+draw_sampler_compressed(const struct sampler_compressed *sc, double u) {
+  /* Use the search table to find a nearby interval */
+  int tablength = SEARCH_TABLE_LENGTH;
+  int int_u = (int)(u * tablength);
+  int i = sc->index[int_u < tablength ? int_u : tablength - 1];
+
+  /* Skip whole blocks, whose first cdf value is stored exactly */
+  const int last = sc->intervalNum - 1;
+  int b = i / COMPRESSED_BLOCK_SIZE;
+  while ((b + 1) * COMPRESSED_BLOCK_SIZE <= last && sc->blocks[b + 1].F0 < u) {
+    b++;
+    i = b * COMPRESSED_BLOCK_SIZE;
+  }
+
+  /* Find the exact interval, i.e. the largest interval such that u > F(p) */
+  const struct compressed_block *blk = &sc->blocks[b];
+  const struct compressed_interval *iv = &sc->intervals[i];
+  double Fl = blk->F0 + blk->F_scale * iv[0].F;
+  double Fr = compressed_cdf(sc, i + 1);
+  while (i < last && Fr < u) {
+    i++;
+    iv++;
+    Fl = Fr;
+    Fr = compressed_cdf(sc, i + 1);
+  }
+
+  /* Decode the interval */
+  double a0 = blk->x0 + blk->x_scale * iv->a0;
+  double a1 = blk->a1_scale * iv->a1;
+  double a2 = blk->a2_scale * iv->a2;
+  double a3 = blk->a3_scale * iv->a3;
+
+  /* Evaluate F^-1(u) using the Hermite approximation of F in this interval */
+  double u_tilde = (u - Fl) / (Fr - Fl);
+  return hermite_cubic(a0, a1, a2, a3, u_tilde);
+}
+
+void draw_sampler_compressed_batch(const struct sampler_compressed *sc,
+                                   const double *u, double *x, int n);
+
+#endif
@@ -0,0 +1,75 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef SAMPLER_FLOAT_H
+#define SAMPLER_FLOAT_H
+
+#include "../include/random.h"
+
+/* A single-precision copy of the runtime tables of a numerical inversion
+ * sampler, for consumers that only need float variates */
+struct sampler_float {
+  /*! The cdf at the left endpoints, with one extra entry F = 1 at the end */
+  float *endpoints;
+
+  /*! The cubic Hermite coefficients a0, a1, a2, a3 of each interval */
+  float *splines;
+
+  /*! The number of intervals */
+  int intervalNum;
+
+  /*! The indexed search table */
+  int *index;
+};
+
+/* Methods for single-precision sampling */
+int init_sampler_float(struct sampler_float *sf, pdf f, double xl, double xr,
+                       double tol, void *params);
+void clean_sampler_float(struct sampler_float *sf);
+
+/**
+ * @brief Transform a uniform random number into a custom variate X = F^-1(u),
+ * using only single-precision arithmetic
+ *
+ * @param sf The #sampler_float for the distribution
+ * @param u Random number to be transformed
+ */
+static inline float draw_sampler_float(const struct sampler_float *sf,
+                                       float u) {
+  /* Use the search table to find a nearby interval */
+  int tablength = SEARCH_TABLE_LENGTH;
+  int int_u = (int)(u * tablength);
+  int i = sf->index[int_u < tablength ? int_u : tablength - 1];
+
+  /* Find the exact interval, i.e. the largest interval such that u > F(p) */
+  while (i < sf->intervalNum - 1 && sf->endpoints[i + 1] < u) i++;
+
+  /* Evaluate F^-1(u) using the Hermite approximation of F in this interval */
+  const float *a = &sf->splines[4 * i];
+  float Fl = sf->endpoints[i];
+  float Fr = sf->endpoints[i + 1];
+  float u_tilde = (u - Fl) / (Fr - Fl);
+
+  return hermite_cubicf(a[0], a[1], a[2], a[3], u_tilde);
+}
+
+void draw_sampler_float_batch(const struct sampler_float *sf, const float *u,
+                              float *x, int n);
+
+#endif
@@ -0,0 +1,87 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef SAMPLER_STREAM_H
+#define SAMPLER_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "../include/random.h"
+
+/* A single-producer single-consumer ring buffer of chunks of variates, filled
+ * by a background thread */
+struct stream_ring {
+  /*! Storage for chunkNum chunks of chunkLength variates */
+  double *data;
+
+  /*! Number of chunks produced, written by the producer only */
+  _Alignas(64) atomic_size_t head;
+
+  /*! Number of chunks released, written by the consumer only */
+  _Alignas(64) atomic_size_t tail;
+
+  /*! Number of variates of the current chunk handed out to the consumer */
+  _Alignas(64) int offset;
+
+  /*! Set while the consumer (0) waits for a new chunk or the producer (1)
+   * waits for a free chunk, in which case the other thread signals the
+   * corresponding condition */
+  _Alignas(64) atomic_int waiting[2];
+  pthread_mutex_t lock;
+  pthread_cond_t cond[2];
+
+  /*! The random number generator of the producer */
+  rng_state state;
+
+  /*! The producer thread */
+  pthread_t thread;
+
+  /*! The stream that the ring belongs to */
+  struct sampler_stream *stream;
+};
+
+/* Background production of variates for a number of consumer threads */
+struct sampler_stream {
+  /*! The sampler used by the producers, which must outlive the stream */
+  struct sampler *s;
+
+  /*! One ring buffer and producer thread per consumer */
+  struct stream_ring *rings;
+  int ringNum;
+
+  /*! Dimensions of the ring buffers */
+  int chunkNum;
+  int chunkLength;
+
+  /*! Flag telling the producers to stop */
+  atomic_int stop;
+};
+
+/* Methods for streaming variates */
+int sampler_stream_start(struct sampler_stream *st, struct sampler *s,
+                         int consumers, int chunkLength, int chunkNum,
+                         uint64_t seed);
+const double *sampler_stream_next(struct sampler_stream *st, int consumer,
+                                  int n, int *got);
+void sampler_stream_stop(struct sampler_stream *st);
+
+#endif
@@ -0,0 +1,87 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+
+#ifndef TABULATED_H
+#define TABULATED_H
+
+#include "../include/random.h"
+
+/* A pdf given as values on a grid, interpolated with a monotone piecewise
+ * cubic Hermite spline (Fritsch-Carlson) */
+struct tabulated_pdf {
+  /*! The grid points, in increasing order */
+  double *x;
+
+  /*! The pdf values at the grid points */
+  double *f;
+
+  /*! The slopes of the interpolating spline at the grid points */
+  double *m;
+
+  /*! The integral of the spline from the first grid point */
+  double *F;
+
+  /*! The number of grid points */
+  int n;
+};
+
+/* A mixture of a continuous distribution and point masses */
+struct mixed_sampler {
+  /*! The sampler for the continuous part, or NULL if purely discrete */
+  struct sampler *continuous;
+
+  /*! The probability of the continuous part */
+  double weight;
+
+  /*! The locations of the point masses, in increasing order */
+  double *atoms;
+
+  /*! The probabilities of the point masses */
+  double *probs;
+
+  /*! The total cdf just below each atom and the total probability of the
+   * atoms up to and including each atom */
+  double *G_lo;
+  double *P;
+
+  /*! The number of point masses */
+  int atomNum;
+};
+
+/* Methods for tabulated pdfs */
+int init_tabulated_pdf(struct tabulated_pdf *t, const double *x,
+                       const double *f, int n);
+void clean_tabulated_pdf(struct tabulated_pdf *t);
+double tabulated_pdf_eval(double x, void *params);
+double tabulated_pdf_deriv(double x, void *params);
+double tabulated_pdf_cdf(double x, void *params);
+int init_sampler_tabulated(struct sampler *s, struct tabulated_pdf *t,
+                           double tol);
+
+/* Methods for mixed discrete and continuous distributions */
+void init_mixed_sampler(struct mixed_sampler *ms, struct sampler *continuous,
+                        double weight, const double *atoms,
+                        const double *probs, int atomNum);
+void clean_mixed_sampler(struct mixed_sampler *ms);
+double draw_mixed_sampler(struct mixed_sampler *ms, double u);
+void draw_mixed_sampler_batch(struct mixed_sampler *ms, const double *u,
+                              double *x, int n);
+
+#endif
@@ -0,0 +1,69 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+
+#ifndef TAIL_SAMPLER_H
+#define TAIL_SAMPLER_H
+
+#include "../include/random.h"
+
+/* Depth of the tail tables, in units of y = -log(Q(x) / p) */
+#define TAIL_DEPTH 46.0
+
+/* Parameters of the transformed cdf of one tail */
+struct tail_params {
+  /*! The pdf of the full distribution and its parameters */
+  pdf f;
+  void *params;
+
+  /*! The end of the tail at the boundary of the domain */
+  double x_end;
+
+  /*! The integral of the pdf over the tail */
+  double mass;
+};
+
+/* A sampler with a core table for the bulk of the distribution and tables
+ * in log space for the tails */
+struct tail_sampler {
+  /*! Tables for the core of the distribution */
+  struct sampler core;
+
+  /*! Tables of x as a function of y = -log(F(x) / p_left) and
+   * y = -log(Q(x) / p_right), where Q = 1 - F */
+  struct sampler left, right;
+
+  /*! The probabilities of the tails, zero if there is no tail table */
+  double p_left, p_right;
+
+  /*! Parameters of the transformed cdfs of the tails */
+  struct tail_params left_params, right_params;
+};
+
+/* Methods for sampling with tail tables */
+int init_tail_sampler(struct tail_sampler *ts, pdf f, double xl, double xr,
+                      double p_left, double p_right, double tol,
+                      void *params);
+void clean_tail_sampler(struct tail_sampler *ts);
+double draw_tail_sampler(struct tail_sampler *ts, double u);
+double sample_tail_sampler(struct tail_sampler *ts, rng_state *state);
+void sample_tail_sampler_batch(struct tail_sampler *ts, rng_state *state,
+                               double *x, int n);
+
+#endif
@@ -21,6 +21,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <float.h>
 
 void generate_header(struct sampler *rng, char *fname);
 
@@ -81,6 +82,11 @@ int main(int argc, char *argv[]) {
     /* Print information */
     printf("Computed cubic splines on %d intervals.\n", rng.intervalNum);
 
+    /* The tables in the header are stored in single precision */
+    if (tolerance < 4 * FLT_EPSILON) {
+        printf("Warning: tolerance cannot be met with single-precision tables.\n");
+    }
+
     /* Dump the tables and an inline rng method to a header file */
     char *fname = argv[1];
     generate_header(&rng, fname);
@@ -122,6 +128,10 @@ void generate_header(struct sampler *rng, char *fname) {
                "*  For more details, refer to https://github.com/wullm/AnyRNG.\n"
                "*/\n\n", fname);
 
+    /* Standard headers */
+    fprintf(f, "#include <stddef.h>\n"
+               "#include <math.h>\n\n");
+
     /* Define the structs */
     fprintf(f, "/* Cubic spline coefficients */\n"
                "struct spline {\n"
@@ -136,12 +146,35 @@ void generate_header(struct sampler *rng, char *fname) {
                "  float *index_table;\n"
                "};\n\n");
 
+    /* Write the polynomial evaluation shared by all transform methods */
+    fprintf(f, "/* Evaluate the cubic a0 + a1 * t + a2 * t^2 + a3 * t^3. If\n"
+               " * ANYRNG_DETERMINISTIC is defined, Horner's scheme is used with explicit\n"
+               " * fused multiply-adds, such that all transform methods give bitwise\n"
+               " * identical results on any instruction set. */\n"
+               "static inline double anyrng_cubic(double a0, double a1, double a2, double a3,\n"
+               "                                  double t) {\n"
+               "#ifdef ANYRNG_DETERMINISTIC\n"
+               "  return fma(t, fma(t, fma(t, a3, a2), a1), a0);\n"
+               "#else\n"
+               "  return a0 + a1 * t + a2 * t * t + a3 * t * t * t;\n"
+               "#endif\n"
+               "}\n\n"
+               "/* Single-precision version of anyrng_cubic, using Horner's scheme */\n"
+               "static inline float anyrng_cubicf(float a0, float a1, float a2, float a3,\n"
+               "                                  float t) {\n"
+               "#ifdef ANYRNG_DETERMINISTIC\n"
+               "  return fmaf(t, fmaf(t, fmaf(t, a3, a2), a1), a0);\n"
+               "#else\n"
+               "  return a0 + t * (a1 + t * (a2 + t * a3));\n"
+               "#endif\n"
+               "}\n\n");
+
     /* Dump the tables */
-    fprintf(f, "static float endpoints[%d] = {\n  ", rng->intervalNum);
+    fprintf(f, "static float endpoints[%d] = {\n  ", rng->intervalNum + 1);
     for (int i=0; i<rng->intervalNum; i++) {
-        fprintf(f, "%e%s%s", rng->intervals[i].Fl, (i < rng->intervalNum-1) ? ", " : "", (i % 5) == 4 ? "\n  " : "");
+        fprintf(f, "%e, %s", rng->intervals[i].Fl, (i % 5) == 4 ? "\n  " : "");
     }
-    fprintf(f, "};\n");
+    fprintf(f, "%e};\n", 1.0);
     fprintf(f, "static struct spline splines[%d] = {\n", rng->intervalNum);
     for (int i=0; i<rng->intervalNum; i++) {
         fprintf(f, "  {%e, %e, %e, %e}%s", rng->intervals[i].a0, rng->intervals[i].a1, rng->intervals[i].a2, rng->intervals[i].a3, (i < rng->intervalNum-1) ? ",\n" : "");
@@ -182,11 +215,36 @@ void generate_header(struct sampler *rng, char *fname) {
                "  struct spline *iv = &anyrng.splines[i];\n\n"
                "  /* Evaluate F^-1(u) using the Hermite approximation of F in this interval */\n"
                "  double u_tilde = (u - Fl) / (Fr - Fl);\n"
-               "  double H = iv->a0 + iv->a1 * u_tilde + iv->a2 * u_tilde * u_tilde +\n"
-               "             iv->a3 * u_tilde * u_tilde * u_tilde;\n\n"
+               "  double H = anyrng_cubic(iv->a0, iv->a1, iv->a2, iv->a3, u_tilde);\n\n"
                "  return H;\n"
                "}\n", SEARCH_TABLE_LENGTH);
 
+    /* Write a single-precision version of the transform method */
+    fprintf(f, "\n"
+               "/**\n"
+               "* @brief Transform a uniform random number into a custom variate X = F^-1(u)\n"
+               "* using only single-precision arithmetic\n"
+               "*\n"
+               "* @param u Random number to be transformed\n"
+               "*/\n"
+               "static inline float transform_variatef(float u) {\n"
+               "  /* Use the search table to find a nearby interval */\n"
+               "  int tablength = %d;\n"
+               "  int int_u = (int)(u * tablength);\n"
+               "  int start = anyrng.index_table[int_u < tablength ? int_u : tablength - 1];\n"
+               "  int i;\n\n"
+               "  /* Find the exact interval, i.e. the largest interval such that u > F(p) */\n"
+               "  for (i = start; i < anyrng.intervalNum-1; i++) {\n"
+               "    if (anyrng.endpoints[i+1] >= u) break;\n"
+               "  }\n\n"
+               "  float Fl = anyrng.endpoints[i];\n"
+               "  float Fr = anyrng.endpoints[i+1];\n"
+               "  struct spline *iv = &anyrng.splines[i];\n\n"
+               "  /* Evaluate F^-1(u) using Horner's scheme in single precision */\n"
+               "  float u_tilde = (u - Fl) / (Fr - Fl);\n"
+               "  return anyrng_cubicf(iv->a0, iv->a1, iv->a2, iv->a3, u_tilde);\n"
+               "}\n", SEARCH_TABLE_LENGTH);
+
    /* Write a transform method for the pdf interpolation */
    if (rng->df != NULL) {
        fprintf(f, "\n"
@@ -211,12 +269,176 @@ void generate_header(struct sampler *rng, char *fname) {
                   "  struct spline *iv = &anyrng.pdf_splines[i];\n\n"
                   "  /* Evaluate f(F^-1(u)) using the Hermite approximation of f */\n"
                   "  double u_tilde = (u - Fl) / (Fr - Fl);\n"
-                  "  double H = iv->a0 + iv->a1 * u_tilde + iv->a2 * u_tilde * u_tilde +\n"
-                  "             iv->a3 * u_tilde * u_tilde * u_tilde;\n\n"
+                  "  double H = anyrng_cubic(iv->a0, iv->a1, iv->a2, iv->a3, u_tilde);\n\n"
                   "  return H;\n"
                   "}\n", SEARCH_TABLE_LENGTH);
     }
 
+    /* Write a fused transform that shares the search for both splines */
+    if (rng->df != NULL) {
+        fprintf(f, "\n"
+                   "/**\n"
+                   "* @brief Transform a uniform random number into a custom variate X = F^-1(u)\n"
+                   "* and evaluate the probability density f(X), with a single interval search\n"
+                   "*\n"
+                   "* @param u Random number to be transformed\n"
+                   "* @param density Output, the probability density at X\n"
+                   "*/\n"
+                   "static inline double transform_variate_and_density(double u, double *density) {\n"
+                   "  /* Use the search table to find a nearby interval */\n"
+                   "  int tablength = %d;\n"
+                   "  int int_u = (int)(u * tablength);\n"
+                   "  int start = anyrng.index_table[int_u < tablength ? int_u : tablength - 1];\n"
+                   "  int i;\n\n"
+                   "  /* Find the exact interval, i.e. the largest interval such that u > F(p) */\n"
+                   "  for (i = start; i < anyrng.intervalNum-1; i++) {\n"
+                   "    if (anyrng.endpoints[i+1] >= u) break;\n"
+                   "  }\n\n"
+                   "  float Fl = anyrng.endpoints[i];\n"
+                   "  float Fr = anyrng.endpoints[i+1];\n"
+                   "  struct spline *iv = &anyrng.splines[i];\n"
+                   "  struct spline *fv = &anyrng.pdf_splines[i];\n\n"
+                   "  /* Evaluate F^-1(u) and f(F^-1(u)) in the same interval */\n"
+                   "  double u_tilde = (u - Fl) / (Fr - Fl);\n"
+                   "  *density = anyrng_cubic(fv->a0, fv->a1, fv->a2, fv->a3, u_tilde);\n"
+                   "  return anyrng_cubic(iv->a0, iv->a1, iv->a2, iv->a3, u_tilde);\n"
+                   "}\n", SEARCH_TABLE_LENGTH);
+    }
+
+    /* Write the shared body of the batch kernels */
+    fprintf(f, "\n"
+               "/* Number of variates that are searched in lockstep by the batch kernels */\n"
+               "#define ANYRNG_BATCH_BLOCK 64\n\n"
+               "/**\n"
+               "* @brief Shared body of the batch kernels, which is compiled for each\n"
+               "* instruction set by inlining it into the target-specific kernels below\n"
+               "*\n"
+               "* @param u Array of random numbers to be transformed\n"
+               "* @param x Output array of custom variates\n"
+               "* @param density Optional output array of densities, or NULL\n"
+               "* @param n Number of random numbers\n"
+               "*/\n"
+               "static inline __attribute__((always_inline)) void\n"
+               "anyrng_batch_kernel(const double *u, double *x, double *density, int n) {\n"
+               "  const int tablength = %d;\n"
+               "  const int last = anyrng.intervalNum - 1;\n"
+               "  const float *ends = anyrng.endpoints;\n"
+               "  const float *guide = anyrng.index_table;\n"
+               "  const struct spline *inv = anyrng.splines;\n"
+               "%s"
+               "  int idx[ANYRNG_BATCH_BLOCK];\n\n"
+               "  for (int k = 0; k < n; k += ANYRNG_BATCH_BLOCK) {\n"
+               "    const int m = (n - k < ANYRNG_BATCH_BLOCK) ? n - k : ANYRNG_BATCH_BLOCK;\n"
+               "    const double *uk = u + k;\n\n"
+               "    /* Use the search table to find a nearby interval in every lane */\n"
+               "    for (int j = 0; j < m; j++) {\n"
+               "      int int_u = (int)(uk[j] * tablength);\n"
+               "      idx[j] = guide[int_u < tablength ? int_u : tablength - 1];\n"
+               "    }\n\n"
+               "    /* Advance all lanes in lockstep by the typical length of the search,\n"
+               "     * without branches such that the loop is vectorized */\n"
+               "    for (int step = 0; step < 2; step++) {\n"
+               "      for (int j = 0; j < m; j++) {\n"
+               "        idx[j] += (idx[j] < last) & (ends[idx[j]+1] < uk[j]);\n"
+               "      }\n"
+               "    }\n\n"
+               "    /* Finish the few lanes with longer searches one by one */\n"
+               "    for (int j = 0; j < m; j++) {\n"
+               "      while (idx[j] < last && ends[idx[j]+1] < uk[j]) idx[j]++;\n"
+               "    }\n\n"
+               "    /* Evaluate the Hermite approximations in every lane */\n"
+               "    for (int j = 0; j < m; j++) {\n"
+               "      int i = idx[j];\n"
+               "      float Fl = ends[i];\n"
+               "      float Fr = ends[i+1];\n"
+               "      const struct spline *iv = &inv[i];\n"
+               "      double u_tilde = (uk[j] - Fl) / (Fr - Fl);\n"
+               "      x[k + j] = anyrng_cubic(iv->a0, iv->a1, iv->a2, iv->a3, u_tilde);\n"
+               "    }\n", SEARCH_TABLE_LENGTH,
+               (rng->df != NULL) ? "  const struct spline *dens = anyrng.pdf_splines;\n"
+                                 : "  (void)density;\n");
+    if (rng->df != NULL) {
+        fprintf(f, "\n"
+                   "    if (density == NULL) continue;\n\n"
+                   "    /* Evaluate the pdf splines in the same intervals */\n"
+                   "    for (int j = 0; j < m; j++) {\n"
+                   "      int i = idx[j];\n"
+                   "      float Fl = ends[i];\n"
+                   "      float Fr = ends[i+1];\n"
+                   "      const struct spline *fv = &dens[i];\n"
+                   "      double u_tilde = (uk[j] - Fl) / (Fr - Fl);\n"
+                   "      density[k + j] = anyrng_cubic(fv->a0, fv->a1, fv->a2, fv->a3, u_tilde);\n"
+                   "    }\n");
+    }
+    fprintf(f, "  }\n"
+               "}\n\n");
+
+    /* Write the kernels for each instruction set and the dispatchers */
+    fprintf(f, "#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))\n"
+               "#define ANYRNG_MULTIVERSION\n"
+               "#endif\n\n"
+               "/* Portable kernel, compiled for the baseline instruction set */\n"
+               "static inline void anyrng_batch_scalar(const double *u, double *x,\n"
+               "                                      double *density, int n) {\n"
+               "  anyrng_batch_kernel(u, x, density, n);\n"
+               "}\n\n"
+               "#ifdef ANYRNG_MULTIVERSION\n"
+               "/* Kernel for processors with AVX2 and FMA */\n"
+               "__attribute__((target(\"avx2,fma\")))\n"
+               "static inline void anyrng_batch_avx2(const double *u, double *x,\n"
+               "                                    double *density, int n) {\n"
+               "  anyrng_batch_kernel(u, x, density, n);\n"
+               "}\n\n"
+               "/* Kernel for processors with AVX-512 */\n"
+               "__attribute__((target(\"avx512f,avx512vl,avx2,fma\")))\n"
+               "static inline void anyrng_batch_avx512(const double *u, double *x,\n"
+               "                                      double *density, int n) {\n"
+               "  anyrng_batch_kernel(u, x, density, n);\n"
+               "}\n"
+               "#endif\n\n"
+               "/* Select the kernel for the instruction set of the running processor */\n"
+               "static inline void anyrng_batch_dispatch(const double *u, double *x,\n"
+               "                                         double *density, int n) {\n"
+               "#ifdef ANYRNG_MULTIVERSION\n"
+               "  __builtin_cpu_init();\n"
+               "  if (__builtin_cpu_supports(\"avx512f\") && __builtin_cpu_supports(\"avx512vl\")) {\n"
+               "    anyrng_batch_avx512(u, x, density, n);\n"
+               "    return;\n"
+               "  } else if (__builtin_cpu_supports(\"avx2\") && __builtin_cpu_supports(\"fma\")) {\n"
+               "    anyrng_batch_avx2(u, x, density, n);\n"
+               "    return;\n"
+               "  }\n"
+               "#endif\n"
+               "  anyrng_batch_scalar(u, x, density, n);\n"
+               "}\n\n"
+               "/**\n"
+               "* @brief Transform an array of uniform random numbers into custom variates,\n"
+               "* using the fastest kernel supported by the processor\n"
+               "*\n"
+               "* @param u Array of random numbers to be transformed\n"
+               "* @param x Output array of custom variates\n"
+               "* @param n Number of random numbers\n"
+               "*/\n"
+               "static inline void transform_variate_batch(const double *u, double *x, int n) {\n"
+               "  anyrng_batch_dispatch(u, x, NULL, n);\n"
+               "}\n");
+    if (rng->df != NULL) {
+        fprintf(f, "\n"
+                   "/**\n"
+                   "* @brief Transform an array of uniform random numbers into custom variates\n"
+                   "* and evaluate the probability density at each variate\n"
+                   "*\n"
+                   "* @param u Array of random numbers to be transformed\n"
+                   "* @param x Output array of custom variates\n"
+                   "* @param density Output array of densities\n"
+                   "* @param n Number of random numbers\n"
+                   "*/\n"
+                   "static inline void transform_variate_and_density_batch(const double *u, double *x,\n"
+                   "                                                       double *density, int n) {\n"
+                   "  anyrng_batch_dispatch(u, x, density, n);\n"
+                   "}\n");
+    }
+
     /* Close the file */
     fclose(f);
 }
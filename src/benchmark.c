@@ -0,0 +1,461 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/* Benchmarks of the random number generators */
+#include "../include/random.h"
+#include "../include/normal.h"
+#include "../include/numa_sampler.h"
+#include "../include/tail_sampler.h"
+#include "../include/sampler2d.h"
+#include "../include/sampler_compressed.h"
+
+/* Standard headers */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+/* Number of variates generated in each benchmark */
+#define BENCH_NUM 10000000
+
+static struct timeval time_start;
+
+static void start_timer(void) {
+    gettimeofday(&time_start, NULL);
+}
+
+static void stop_timer(const char *name, double tot, double tot2, long num) {
+    struct timeval time_stop;
+    gettimeofday(&time_stop, NULL);
+    long unsigned microsec = (time_stop.tv_sec - time_start.tv_sec) * 1000000
+                           + time_stop.tv_usec - time_start.tv_usec;
+    printf("%-32s %8.2f ns/variate   mean %+.2e   var %.5f\n", name,
+           1e3 * microsec / num, tot / num, tot2 / num - (tot / num) * (tot / num));
+}
+
+/* Fermi-Dirac distribution used for the sampler benchmarks */
+static double fermi_dirac_pdf(double x, void *params) {
+    double *pars = (double *)params;
+    return (x <= 0.0) ? 0.0 : x * x / (exp((x - pars[1]) / pars[0]) + 1.0);
+}
+
+/* Work done by every thread in the NUMA benchmark */
+struct numa_task {
+    struct numa_sampler *ns;
+    struct sampler *shared;
+    int node, k, replicated;
+    long num;
+    double tot;
+};
+
+static void *numa_worker(void *arg) {
+    struct numa_task *task = (struct numa_task *)arg;
+    numa_sampler_bind(task->ns, task->node, task->k);
+
+    /* Use the local replica or the tables allocated by the main thread */
+    struct sampler *s = task->replicated ? numa_sampler_local(task->ns)
+                                         : task->shared;
+    rng_state seed = rand_uint64_init(1000 * task->node + task->k);
+    task->tot = 0;
+    for (long i=0; i<task->num; i++) {
+        task->tot += draw_sampler(s, sampleUniform(&seed));
+    }
+    return NULL;
+}
+
+/* Throughput of parallel sampling with shared and replicated tables, using
+ * all cpus on an increasing number of NUMA nodes */
+static void bench_numa(void) {
+    double pars[2] = {1.0, 0.0};
+    struct sampler s;
+    init_sampler(&s, fermi_dirac_pdf, NULL, 1e-5, 25.0, 1e-13, pars);
+
+    struct numa_sampler ns;
+    init_numa_sampler(&ns, &s);
+
+    printf("\nParallel sampling with %d intervals on %d NUMA node(s):\n",
+           s.intervalNum, ns.nodeNum);
+
+    int maxThreads = 0;
+    for (int cpu=0; cpu<ns.cpuNum; cpu++) {
+        maxThreads += (ns.cpu_node[cpu] >= 0);
+    }
+    struct numa_task *tasks = malloc(maxThreads * sizeof(struct numa_task));
+    pthread_t *threads = malloc(maxThreads * sizeof(pthread_t));
+
+    for (int nodes=1; nodes<=ns.nodeNum; nodes++) {
+        for (int replicated=0; replicated<2; replicated++) {
+            /* One thread for every cpu on the first few nodes */
+            int threadNum = 0;
+            for (int node=0; node<nodes; node++) {
+                int k = 0;
+                for (int cpu=0; cpu<ns.cpuNum; cpu++) {
+                    if (ns.cpu_node[cpu] != node) continue;
+                    struct numa_task task = {&ns, &s, node, k++, replicated,
+                                             BENCH_NUM, 0.};
+                    tasks[threadNum++] = task;
+                }
+            }
+
+            start_timer();
+            for (int t=0; t<threadNum; t++) {
+                pthread_create(&threads[t], NULL, numa_worker, &tasks[t]);
+            }
+            double tot = 0;
+            for (int t=0; t<threadNum; t++) {
+                pthread_join(threads[t], NULL);
+                tot += tasks[t].tot;
+            }
+
+            struct timeval time_stop;
+            gettimeofday(&time_stop, NULL);
+            double sec = (time_stop.tv_sec - time_start.tv_sec)
+                       + 1e-6 * (time_stop.tv_usec - time_start.tv_usec);
+            double rate = threadNum * (double) BENCH_NUM / sec;
+            printf("%d node(s), %3d threads, %-10s tables: %8.1f M variates/s"
+                   "   mean %.4f\n", nodes, threadNum,
+                   replicated ? "replicated" : "shared", rate / 1e6,
+                   tot / (threadNum * (double) BENCH_NUM));
+        }
+    }
+
+    free(tasks);
+    free(threads);
+    clean_numa_sampler(&ns);
+    clean_sampler(&s);
+}
+
+/* Batch sampling from large tables, with and without prefetching and
+ * huge pages */
+static void bench_large_tables(void) {
+    double pars[2] = {1.0, 0.0};
+    struct sampler s;
+    init_sampler(&s, fermi_dirac_pdf, NULL, 1e-5, 25.0, 1e-13, pars);
+
+    printf("\nSampling with %d intervals (%.1f kB of tables):\n",
+           s.intervalNum, s.intervalNum * sizeof(struct interval) / 1024.);
+
+    int block = 4096;
+    long num = BENCH_NUM / block * block;
+    double *u = malloc(block * sizeof(double));
+    double *x = malloc(block * sizeof(double));
+
+    for (int pass=0; pass<2; pass++) {
+        const char *names[2][2] = {{"draw_sampler", "draw_sampler_batch"},
+                                   {"draw_sampler (huge pages)",
+                                    "draw_sampler_batch (huge pages)"}};
+
+        rng_state seed = rand_uint64_init(102);
+        double tot = 0, tot2 = 0;
+        start_timer();
+        for (long i=0; i<num; i++) {
+            double y = draw_sampler(&s, sampleUniform(&seed));
+            tot += y;
+            tot2 += y * y;
+        }
+        stop_timer(names[pass][0], tot, tot2, num);
+
+        seed = rand_uint64_init(102);
+        tot = tot2 = 0;
+        start_timer();
+        for (long i=0; i<num; i+=block) {
+            for (int j=0; j<block; j++) {
+                u[j] = sampleUniform(&seed);
+            }
+            draw_sampler_batch(&s, u, x, block);
+            for (int j=0; j<block; j++) {
+                tot += x[j];
+                tot2 += x[j] * x[j];
+            }
+        }
+        stop_timer(names[pass][1], tot, tot2, num);
+
+        if (pass == 0) {
+            int transparent = sampler_use_hugepages(&s);
+            if (s.table_memory == NULL) {
+                printf("Tables are too small for huge pages\n");
+            } else {
+                printf("Moved tables into %s huge pages\n",
+                       transparent ? "transparent" : "explicit");
+            }
+        }
+    }
+
+    free(u);
+    free(x);
+    clean_sampler(&s);
+}
+
+static void bench_compressed(void) {
+    double pars[2] = {1.0, 0.0};
+    struct sampler s;
+    init_sampler(&s, fermi_dirac_pdf, NULL, 1e-5, 25.0, 1e-13, pars);
+
+    struct sampler_compressed sc;
+    double tol = 1e-11;
+    double error = compress_sampler(&sc, &s, tol);
+    size_t bytes = (s.intervalNum + 1) * sizeof(struct compressed_interval) +
+                   (s.intervalNum / COMPRESSED_BLOCK_SIZE + 1) *
+                       sizeof(struct compressed_block);
+
+    printf("\nCompressed tables (%.1f kB, added error %s %.0e):\n",
+           bytes / 1024., error == 0. ? "within" : "exceeds", tol);
+
+    int block = 4096;
+    long num = BENCH_NUM / block * block;
+    double *u = malloc(block * sizeof(double));
+    double *x = malloc(block * sizeof(double));
+
+    rng_state seed = rand_uint64_init(102);
+    double tot = 0, tot2 = 0;
+    start_timer();
+    for (long i=0; i<num; i++) {
+        double y = draw_sampler_compressed(&sc, sampleUniform(&seed));
+        tot += y;
+        tot2 += y * y;
+    }
+    stop_timer("draw_sampler_compressed", tot, tot2, num);
+
+    seed = rand_uint64_init(102);
+    tot = tot2 = 0;
+    start_timer();
+    for (long i=0; i<num; i+=block) {
+        for (int j=0; j<block; j++) {
+            u[j] = sampleUniform(&seed);
+        }
+        draw_sampler_compressed_batch(&sc, u, x, block);
+        for (int j=0; j<block; j++) {
+            tot += x[j];
+            tot2 += x[j] * x[j];
+        }
+    }
+    stop_timer("draw_sampler_compressed_batch", tot, tot2, num);
+
+    free(u);
+    free(x);
+    clean_sampler_compressed(&sc);
+    clean_sampler(&s);
+}
+
+/* Compare double comparison for qsort */
+static int compare_double(const void *a, const void *b) {
+    double da = *(const double *)a, db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+/* Sorted output: drawing and sorting versus sorted and stratified draws */
+static void bench_sorted(void) {
+    double pars[2] = {1.0, 0.0};
+    struct sampler s;
+    init_sampler(&s, fermi_dirac_pdf, NULL, 1e-5, 25.0, 1e-10, pars);
+
+    printf("\nSorted variates from a sampler with %d intervals:\n",
+           s.intervalNum);
+
+    int block = 100000;
+    long num = BENCH_NUM / block * block;
+    double *u = malloc(block * sizeof(double));
+    double *x = malloc(block * sizeof(double));
+    rng_state seed = rand_uint64_init(103);
+    double tot, tot2;
+
+    for (int mode=0; mode<3; mode++) {
+        const char *names[3] = {"draw_sampler_batch + qsort",
+                                "draw_sampler_sorted",
+                                "draw_sampler_stratified"};
+        int sorted = 1;
+        tot = tot2 = 0;
+        start_timer();
+        for (long i=0; i<num; i+=block) {
+            if (mode == 0) {
+                for (int j=0; j<block; j++) {
+                    u[j] = sampleUniform(&seed);
+                }
+                draw_sampler_batch(&s, u, x, block);
+                qsort(x, block, sizeof(double), compare_double);
+            } else if (mode == 1) {
+                draw_sampler_sorted(&s, &seed, x, block);
+            } else {
+                draw_sampler_stratified(&s, &seed, x, block);
+            }
+            for (int j=0; j<block; j++) {
+                tot += x[j];
+                tot2 += x[j] * x[j];
+                if (j > 0 && x[j] < x[j-1]) sorted = 0;
+            }
+        }
+        stop_timer(names[mode], tot, tot2, num);
+        if (!sorted) printf("Error: output of %s is not sorted\n", names[mode]);
+    }
+
+    free(u);
+    free(x);
+    clean_sampler(&s);
+}
+
+/* Standard normal distribution, unnormalized */
+static double gaussian_pdf(double x, void *params) {
+    (void)params;
+    return exp(-0.5 * x * x);
+}
+
+/* Sampling with a small core table and log-space tail tables */
+static void bench_tails(void) {
+    struct sampler s;
+    init_sampler(&s, gaussian_pdf, NULL, -8.0, 8.0, 1e-7, NULL);
+
+    struct tail_sampler ts;
+    if (init_tail_sampler(&ts, gaussian_pdf, -12.0, 12.0, 1e-3, 1e-3, 1e-7,
+                          NULL) != 0) {
+        printf("Warning: the tail tables do not meet the tolerance\n");
+    }
+
+    printf("\nGaussian with %d intervals on [-8, 8], or %d + %d + %d intervals "
+           "on [-12, 12] with tail tables:\n", s.intervalNum,
+           ts.left.intervalNum, ts.core.intervalNum, ts.right.intervalNum);
+
+    rng_state seed = rand_uint64_init(104);
+    double tot = 0, tot2 = 0;
+    start_timer();
+    for (long i=0; i<BENCH_NUM; i++) {
+        double x = draw_sampler(&s, sampleUniform(&seed));
+        tot += x;
+        tot2 += x * x;
+    }
+    stop_timer("draw_sampler", tot, tot2, BENCH_NUM);
+
+    long deep = 0;
+    tot = tot2 = 0;
+    start_timer();
+    for (long i=0; i<BENCH_NUM; i++) {
+        double x = sample_tail_sampler(&ts, &seed);
+        tot += x;
+        tot2 += x * x;
+        deep += (x > 4.0);
+    }
+    stop_timer("sample_tail_sampler", tot, tot2, BENCH_NUM);
+    printf("Fraction beyond 4 sigma: %.3e (expected %.3e)\n",
+           (double) deep / BENCH_NUM, 0.5 * erfc(4.0 / sqrt(2.0)));
+
+    clean_tail_sampler(&ts);
+    clean_sampler(&s);
+}
+
+/* Bivariate normal distribution with correlation coefficient rho */
+static double bivariate_pdf(double x, double y, void *params) {
+    double rho = *(double *)params;
+    return exp(-(x * x - 2 * rho * x * y + y * y) / (2 * (1 - rho * rho)));
+}
+
+/* Joint sampling of (x, y) pairs with marginal and conditional tables */
+static void bench_2d(void) {
+    double rho = 0.8;
+    struct sampler2d s2;
+    start_timer();
+    init_sampler2d(&s2, bivariate_pdf, -4.0, 4.0, -4.0, 4.0, 1e-6, &rho);
+
+    struct timeval time_stop;
+    gettimeofday(&time_stop, NULL);
+    double ms = 1e3 * (time_stop.tv_sec - time_start.tv_sec)
+              + 1e-3 * (time_stop.tv_usec - time_start.tv_usec);
+    printf("\nBivariate normal (rho = %.1f) with %d conditional tables, "
+           "built in %.1f ms:\n", rho, s2.gridNum, ms);
+
+    rng_state seed = rand_uint64_init(105);
+    double tot = 0, tot2 = 0, cov = 0;
+    start_timer();
+    for (long i=0; i<BENCH_NUM; i++) {
+        double x, y;
+        draw_sampler2d(&s2, sampleUniform(&seed), sampleUniform(&seed), &x, &y);
+        tot += y;
+        tot2 += y * y;
+        cov += x * y;
+    }
+    stop_timer("draw_sampler2d (y)", tot, tot2, BENCH_NUM);
+    printf("Covariance: %.5f\n", cov / BENCH_NUM);
+
+    clean_sampler2d(&s2);
+}
+
+/* Compare the different ways of generating Gaussian variates */
+static void bench_normal(void) {
+    rng_state seed = rand_uint64_init(101);
+    long num = BENCH_NUM;
+    double tot, tot2;
+
+    printf("\nStandard normal variates:\n");
+
+    start_timer();
+    tot = tot2 = 0;
+    for (long i=0; i<num; i++) {
+        double z = sampleNorm(&seed);
+        tot += z;
+        tot2 += z * z;
+    }
+    stop_timer("sampleNorm (Box-Mueller)", tot, tot2, num);
+
+    start_timer();
+    tot = tot2 = 0;
+    struct normal_cache cache = {0., 0};
+    for (long i=0; i<num; i++) {
+        double z = sampleNormCached(&seed, &cache);
+        tot += z;
+        tot2 += z * z;
+    }
+    stop_timer("sampleNormCached (Box-Mueller)", tot, tot2, num);
+
+    struct ziggurat zig;
+    init_ziggurat(&zig);
+
+    start_timer();
+    tot = tot2 = 0;
+    for (long i=0; i<num; i++) {
+        double z = sampleNormZiggurat(&zig, &seed);
+        tot += z;
+        tot2 += z * z;
+    }
+    stop_timer("sampleNormZiggurat", tot, tot2, num);
+
+    int block = 4096;
+    double *z = malloc(block * sizeof(double));
+    start_timer();
+    tot = tot2 = 0;
+    for (long i=0; i<num; i+=block) {
+        fillNorm(&zig, &seed, z, block);
+        for (int j=0; j<block; j++) {
+            tot += z[j];
+            tot2 += z[j] * z[j];
+        }
+    }
+    stop_timer("fillNorm (ziggurat, batch)", tot, tot2, num);
+    free(z);
+}
+
+int main() {
+    bench_normal();
+    bench_large_tables();
+    bench_compressed();
+    bench_sorted();
+    bench_tails();
+    bench_2d();
+    bench_numa();
+
+    return 0;
+}
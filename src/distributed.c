@@ -0,0 +1,357 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "../include/distributed.h"
+
+/**
+ * @brief Initialize a sampler together with other processes
+ *
+ * @param s The #sampler to initialize
+ * @param t The #build_transport connecting the processes
+ * @param f Function reference of the probability density function
+ * @param df Optional function reference to derivative of pdf, can be NULL
+ * @param xl Left endpoint of the domain
+ * @param xr Right endpoint of the domain
+ * @param tol Tolerance for the Hermite interpolation
+ * @param params Parameters to be passed to the pdf
+ *
+ * Every process computes the cheap initial partition of the domain into
+ * intervals covering at most 5% of the probability. The partition is divided
+ * into contiguous groups, which are refined by different processes. The
+ * refined intervals are then exchanged, such that every process ends up with
+ * the same tables as a serial call to init_sampler. This is a collective
+ * operation and all processes return the same value: 0 on success, 1 if the
+ * tolerance could not be met everywhere (see refine_intervals), in which case
+ * the tables are still usable, and -1 if the exchange failed, in which case
+ * the sampler is cleaned.
+ */
+int init_sampler_distributed(struct sampler *s, struct build_transport *t,
+                             pdf f, pdf df, double xl, double xr, double tol,
+                             void *params) {
+  /* Normalize the pdf and create the initial intervals, in the same way on
+   * every process */
+  prepare_sampler(s, f, NULL, df, xl, xr, tol, params);
+  build_search_table(s);
+
+  /* The group of initial intervals refined by this process */
+  const int initialNum = s->intervalNum;
+  const int first = (long)initialNum * t->rank / t->size;
+  const int last = (long)initialNum * (t->rank + 1) / t->size;
+
+  struct interval *send = NULL;
+  int sendNum = 0;
+  int status = 0;
+  if (first < last) {
+    /* Refine the group, which ends at the last interval of the group */
+    s->intervals[last - 1].nid = -1;
+    status = refine_intervals(s, first, tol);
+
+    /* Collect the intervals of the group, including those split off, which
+     * were appended to the array */
+    int addedNum = s->intervalNum - initialNum;
+    sendNum = (last - first) + addedNum;
+    send = malloc(sendNum * sizeof(struct interval));
+    if (send != NULL) {
+      memcpy(send, s->intervals + first,
+             (last - first) * sizeof(struct interval));
+      memcpy(send + (last - first), s->intervals + initialNum,
+             addedNum * sizeof(struct interval));
+    } else {
+      sendNum = 0;
+      status = -1;
+    }
+  }
+
+  /* Agree on the outcome of the refinement, such that all processes return
+   * the same value and either all or none of them exchange the intervals */
+  void *recv;
+  size_t recv_bytes;
+  int err = t->allgatherv(t, &status, sizeof(int), &recv, &recv_bytes);
+  if (!err) {
+    const int *statuses = (const int *)recv;
+    for (int r = 0; r < t->size; r++) {
+      if (statuses[r] < 0) {
+        status = -1;
+      } else if (statuses[r] > 0 && status == 0) {
+        status = statuses[r];
+      }
+    }
+    free(recv);
+  }
+
+  /* Exchange the refined intervals between all processes */
+  if (!err && status >= 0) {
+    err = t->allgatherv(t, send, sendNum * sizeof(struct interval), &recv,
+                        &recv_bytes);
+  }
+  free(send);
+
+  if (err || status < 0) {
+    clean_sampler(s);
+    return -1;
+  }
+
+  /* Sort the merged intervals and generate the search tables */
+  free(s->intervals);
+  s->intervals = (struct interval *)recv;
+  s->intervalNum = recv_bytes / sizeof(struct interval);
+  build_search_table(s);
+
+  return status;
+}
+
+/* Offset of the data blocks from the start of the shared memory segment */
+static size_t shm_data_offset(int size) {
+  size_t header = sizeof(struct shm_segment) + size * sizeof(size_t);
+  return (header + 63) / 64 * 64;
+}
+
+/* Exchange blocks through the shared memory segment. The blocks are packed
+ * one after the other, so a process may send more than its share of the
+ * capacity as long as the blocks of all processes fit together. */
+static int shm_allgatherv(struct build_transport *t, const void *send,
+                          size_t bytes, void **recv, size_t *recv_bytes) {
+  struct shm_transport *st = (struct shm_transport *)t->ctx;
+  struct shm_segment *seg = st->segment;
+  char *data = (char *)seg + shm_data_offset(t->size);
+
+  /* Publish the size of our block */
+  seg->bytes[t->rank] = bytes;
+  pthread_barrier_wait(&seg->barrier);
+
+  /* Our block starts after those of the lower ranks */
+  size_t offset = 0, total = 0;
+  for (int r = 0; r < t->size; r++) {
+    if (r == t->rank) offset = total;
+    total += seg->bytes[r];
+  }
+
+  /* The blocks are only exchanged if they all fit, which every process
+   * decides in the same way */
+  int err = (total > seg->capacity);
+  if (!err) memcpy(data + offset, send, bytes);
+  pthread_barrier_wait(&seg->barrier);
+
+  if (!err) {
+    *recv = malloc(total > 0 ? total : 1);
+    *recv_bytes = total;
+    if (*recv != NULL) {
+      memcpy(*recv, data, total);
+    } else {
+      err = 1;
+    }
+  }
+
+  /* Make sure that everyone has read the blocks before they are reused */
+  pthread_barrier_wait(&seg->barrier);
+
+  return err;
+}
+
+/**
+ * @brief Create a shared memory transport for processes on a single node,
+ * to be called by the parent process before shm_transport_fork
+ *
+ * @param t The #shm_transport to create
+ * @param size The total number of processes, including the parent
+ * @param capacity Maximum number of bytes exchanged by all processes
+ * together, or 0 for the largest table that the refinement can produce
+ *
+ * Since the refinement work is rarely divided evenly, the capacity is shared
+ * between the processes instead of being split into equal parts. The default
+ * reserves MAX_INTERVAL_NUM intervals, but only the pages that are written
+ * take up memory. Returns 0 on success.
+ */
+int shm_transport_create(struct shm_transport *t, int size, size_t capacity) {
+  if (capacity == 0) capacity = MAX_INTERVAL_NUM * sizeof(struct interval);
+
+  /* Create a POSIX shared memory object with a unique name */
+  char name[64];
+  static int counter = 0;
+  snprintf(name, sizeof(name), "/anyrng-%d-%d", (int)getpid(), counter++);
+  int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) return 1;
+
+  t->mapped = shm_data_offset(size) + capacity;
+  if (ftruncate(fd, t->mapped) != 0) {
+    close(fd);
+    shm_unlink(name);
+    return 1;
+  }
+
+  /* The mapping is inherited by the children, so the name can be removed */
+  t->segment = mmap(NULL, t->mapped, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  shm_unlink(name);
+  if (t->segment == MAP_FAILED) return 1;
+
+  /* The barrier synchronizes all processes */
+  pthread_barrierattr_t attr;
+  pthread_barrierattr_init(&attr);
+  pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+  pthread_barrier_init(&t->segment->barrier, &attr, size);
+  pthread_barrierattr_destroy(&attr);
+  t->segment->capacity = capacity;
+
+  t->children = NULL;
+  t->base.rank = 0;
+  t->base.size = size;
+  t->base.allgatherv = shm_allgatherv;
+  t->base.ctx = t;
+
+  return 0;
+}
+
+/**
+ * @brief Fork the other processes that share the transport
+ *
+ * @param t The #shm_transport created by the parent
+ *
+ * Returns the rank of the calling process: 0 in the parent and 1, 2, ... in
+ * the children. Children should call shm_transport_destroy and exit when done.
+ * Returns -1 if a process could not be forked. The children forked until then
+ * would wait forever for the missing process at the first exchange, so they
+ * are killed and reaped, and the transport can then only be destroyed.
+ */
+int shm_transport_fork(struct shm_transport *t) {
+  t->children = malloc(t->base.size * sizeof(pid_t));
+  if (t->children == NULL) return -1;
+
+  for (int r = 1; r < t->base.size; r++) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      free(t->children);
+      t->children = NULL;
+      t->base.rank = r;
+      return r;
+    } else if (pid < 0) {
+      for (int c = 1; c < r; c++) {
+        kill(t->children[c], SIGKILL);
+        waitpid(t->children[c], NULL, 0);
+      }
+      free(t->children);
+      t->children = NULL;
+      return -1;
+    }
+    t->children[r] = pid;
+  }
+  return 0;
+}
+
+/**
+ * @brief Unmap the shared memory. In the parent, this first waits for the
+ * children to exit.
+ *
+ * @param t The #shm_transport to destroy
+ */
+void shm_transport_destroy(struct shm_transport *t) {
+  if (t->children != NULL) {
+    for (int r = 1; r < t->base.size; r++) {
+      waitpid(t->children[r], NULL, 0);
+    }
+    free(t->children);
+    t->children = NULL;
+    pthread_barrier_destroy(&t->segment->barrier);
+  }
+  munmap(t->segment, t->mapped);
+}
+
+#ifdef WITH_MPI
+/* Agree on a failure of any process, such that either all or none of them
+ * enter the following collective */
+static int mpi_any_failed(MPI_Comm comm, int failed) {
+  int any = 1;
+  int err = MPI_Allreduce(&failed, &any, 1, MPI_INT, MPI_LOR, comm);
+  return err != MPI_SUCCESS || any;
+}
+
+/* Exchange blocks with MPI */
+static int mpi_allgatherv(struct build_transport *t, const void *send,
+                          size_t bytes, void **recv, size_t *recv_bytes) {
+  MPI_Comm comm = *(MPI_Comm *)t->ctx;
+  int *counts = malloc(t->size * sizeof(int));
+  int *displs = malloc(t->size * sizeof(int));
+  *recv = NULL;
+  *recv_bytes = 0;
+
+  /* MPI counts blocks and displacements with an int */
+  int err = mpi_any_failed(comm, counts == NULL || displs == NULL ||
+                                     bytes > INT_MAX);
+
+  /* Exchange the sizes of the blocks */
+  int count = (int)bytes;
+  if (!err) {
+    err = MPI_Allgather(&count, 1, MPI_INT, counts, 1, MPI_INT, comm) !=
+          MPI_SUCCESS;
+  }
+
+  /* Every process computes the same total, so all of them reject it */
+  long long total = 0;
+  for (int r = 0; !err && r < t->size; r++) {
+    displs[r] = (int)total;
+    total += counts[r];
+    if (total > INT_MAX) err = 1;
+  }
+
+  /* Exchange the blocks */
+  if (!err) {
+    *recv = malloc(total > 0 ? (size_t)total : 1);
+    err = mpi_any_failed(comm, *recv == NULL);
+  }
+  if (!err) {
+    err = MPI_Allgatherv(send, count, MPI_BYTE, *recv, counts, displs,
+                         MPI_BYTE, comm) != MPI_SUCCESS;
+  }
+
+  if (err) {
+    free(*recv);
+    *recv = NULL;
+  } else {
+    *recv_bytes = total;
+  }
+
+  free(counts);
+  free(displs);
+  return err;
+}
+
+/**
+ * @brief Initialize a transport that uses an MPI communicator
+ *
+ * @param t The #build_transport to initialize
+ * @param comm The communicator, which must outlive the transport
+ */
+void mpi_transport_init(struct build_transport *t, MPI_Comm *comm) {
+  MPI_Comm_rank(*comm, &t->rank);
+  MPI_Comm_size(*comm, &t->size);
+  t->allgatherv = mpi_allgatherv;
+  t->ctx = comm;
+}
+#endif
@@ -25,6 +25,7 @@
 
 /* Standard headers */
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/time.h>
 
 int main() {
@@ -54,5 +55,53 @@ int main() {
                            + time_stop.tv_usec - time_start.tv_usec;
     printf("\nTime elapsed: %.5f s\n", microsec/1e6);
 
+    /* Repeat the exercise in single precision */
+    gettimeofday(&time_start, NULL);
+
+    double totf = 0;
+    for (int i=0; i<num; i+=2) {
+        /* Generate two uniform random numbers from one 64-bit integer */
+        float u0, u1;
+        sampleUniformf2(&seed, &u0, &u1);
+        /* Transform to custom distribution */
+        totf += transform_variatef(u0) + transform_variatef(u1);
+    }
+
+    printf("\nMean (single precision): %e\n", totf/num);
+
+    gettimeofday(&time_stop, NULL);
+    microsec = (time_stop.tv_sec - time_start.tv_sec) * 1000000
+             + time_stop.tv_usec - time_start.tv_usec;
+    printf("\nTime elapsed: %.5f s\n", microsec/1e6);
+
+    /* Repeat the exercise with the batch kernel, which also evaluates the
+     * density at the variates using the same interval search */
+    double *u = malloc(num * sizeof(double));
+    double *x = malloc(num * sizeof(double));
+    double *density = malloc(num * sizeof(double));
+    for (int i=0; i<num; i++) {
+        u[i] = sampleUniform(&seed);
+    }
+
+    gettimeofday(&time_start, NULL);
+
+    transform_variate_and_density_batch(u, x, density, num);
+
+    double totb = 0;
+    for (int i=0; i<num; i++) {
+        totb += x[i];
+    }
+
+    printf("\nMean (batch): %e\n", totb/num);
+
+    gettimeofday(&time_stop, NULL);
+    microsec = (time_stop.tv_sec - time_start.tv_sec) * 1000000
+             + time_stop.tv_usec - time_start.tv_usec;
+    printf("\nTime elapsed: %.5f s\n", microsec/1e6);
+
+    free(u);
+    free(x);
+    free(density);
+
     return 0;
 }
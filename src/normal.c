@@ -0,0 +1,138 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "../include/normal.h"
+
+/* Parameters of the 256-layer ziggurat for the normal distribution: the start
+ * of the tail and the area of each layer (Marsaglia & Tsang, 2000) */
+#define ZIGGURAT_R 3.6541528853610088
+#define ZIGGURAT_V 0.00492867323399
+
+/* Generate standard normal variable with Box-Mueller */
+double sampleNorm(rng_state *state) {
+    /* Generate random integers */
+    const uint64_t A = rand_uint64(state);
+    const uint64_t B = rand_uint64(state);
+    const double RMax = (double) UINT64_MAX + 1;
+
+    /* Map the random integers to the open (!) unit interval */
+    const double u = ((double) A + 0.5) / RMax;
+    const double v = ((double) B + 0.5) / RMax;
+
+    /* Map to two Gaussians (the second is not used - inefficient) */
+    const double z0 = sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+    //double z1 = sqrt(-2 * log(u)) * sin(2 * M_PI * v);
+
+    return z0;
+}
+
+/* Generate two independent standard normal variables with Box-Mueller */
+void sampleNormPair(rng_state *state, double *z0, double *z1) {
+    /* Map two random integers to the open unit interval */
+    const double u = sampleUniform(state);
+    const double v = sampleUniform(state);
+
+    /* Map to two Gaussians */
+    const double rho = sqrt(-2 * log(u));
+    *z0 = rho * cos(2 * M_PI * v);
+    *z1 = rho * sin(2 * M_PI * v);
+}
+
+/**
+ * @brief Compute the tables for the ziggurat method
+ *
+ * @param z The #ziggurat to initialize
+ */
+void init_ziggurat(struct ziggurat *z) {
+  const double r = ZIGGURAT_R;
+  const double v = ZIGGURAT_V;
+  const double fr = exp(-0.5 * r * r);
+
+  /* The base layer consists of a rectangle and the tail beyond r */
+  z->x[0] = v / fr;
+  z->x[1] = r;
+
+  /* Each subsequent layer has the same area v */
+  for (int i = 1; i < ZIGGURAT_LAYERS - 1; i++) {
+    z->x[i + 1] = sqrt(-2 * log(v / z->x[i] + exp(-0.5 * z->x[i] * z->x[i])));
+  }
+  z->x[ZIGGURAT_LAYERS] = 0.;
+
+  for (int i = 0; i < ZIGGURAT_LAYERS; i++) {
+    z->ratio[i] = z->x[i + 1] / z->x[i];
+  }
+  for (int i = 0; i <= ZIGGURAT_LAYERS; i++) {
+    z->fx[i] = exp(-0.5 * z->x[i] * z->x[i]);
+  }
+}
+
+/**
+ * @brief Slow path of the ziggurat method, for points outside the rectangular
+ * part of a layer
+ *
+ * @param z The #ziggurat tables
+ * @param state The random number generator state
+ * @param i The layer of the rejected point
+ * @param x The rejected point
+ */
+double ziggurat_slow(const struct ziggurat *z, rng_state *state, int i,
+                     double x) {
+  while (1) {
+    if (i == 0) {
+      /* Sample from the tail beyond r (Marsaglia, 1964) */
+      const double r = ZIGGURAT_R;
+      double a, b;
+      do {
+        a = -log(sampleUniform(state)) / r;
+        b = -log(sampleUniform(state));
+      } while (b + b < a * a);
+      return (x > 0) ? r + a : -(r + a);
+    }
+
+    /* Accept points in the wedge below the density */
+    const double y = z->fx[i] + sampleUniform(state) * (z->fx[i + 1] - z->fx[i]);
+    if (y < exp(-0.5 * x * x)) return x;
+
+    /* Otherwise, start over with a new point */
+    const uint64_t A = rand_uint64(state);
+    const double u = (double)((int64_t)A >> 11) * 0x1p-52;
+    i = A & (ZIGGURAT_LAYERS - 1);
+    x = u * z->x[i];
+    if (fabs(u) < z->ratio[i]) return x;
+  }
+}
+
+/**
+ * @brief Fill an array with standard normal variates using the ziggurat
+ * method
+ *
+ * @param z The #ziggurat tables
+ * @param state The random number generator state
+ * @param out Output array
+ * @param n Number of variates
+ */
+void fillNorm(const struct ziggurat *z, rng_state *state, double *out,
+              size_t n) {
+  for (size_t k = 0; k < n; k++) {
+    out[k] = sampleNormZiggurat(z, state);
+  }
+}
@@ -0,0 +1,188 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "../include/numa_sampler.h"
+
+#define NUMA_SYSFS "/sys/devices/system/node"
+#define NUMA_MAX_CPUS 4096
+
+/* Arguments for the threads that copy the tables onto each node */
+struct replica_task {
+  struct numa_sampler *ns;
+  struct sampler *s;
+  int node;
+};
+
+/* Read the cpus of a node from a list like "0-3,8-11". Returns the number of
+ * cpus found, or -1 if the node does not exist. */
+static int read_node_cpus(struct numa_sampler *ns, int node) {
+  char fname[128];
+  snprintf(fname, sizeof(fname), NUMA_SYSFS "/node%d/cpulist", node);
+  FILE *f = fopen(fname, "r");
+  if (f == NULL) return -1;
+
+  int count = 0, a, b;
+  while (fscanf(f, "%d", &a) == 1) {
+    b = a;
+    if (fscanf(f, "-%d", &b) != 1) b = a;
+    for (int cpu = a; cpu <= b && cpu < ns->cpuNum; cpu++) {
+      ns->cpu_node[cpu] = node;
+      count++;
+    }
+    if (fgetc(f) != ',') break;
+  }
+
+  fclose(f);
+  return count;
+}
+
+/* Copy the tables from a thread that runs on the given node, such that the
+ * pages are first touched, and therefore allocated, on that node */
+static void *replicate_on_node(void *arg) {
+  struct replica_task *task = (struct replica_task *)arg;
+  numa_sampler_bind(task->ns, task->node, -1);
+  copy_sampler(&task->ns->replicas[task->node], task->s);
+  return NULL;
+}
+
+/**
+ * @brief Replicate the tables of a sampler on every NUMA node
+ *
+ * @param ns The #numa_sampler to initialize
+ * @param s The initialized #sampler to replicate
+ *
+ * The nodes are read from sysfs. If this fails, a single node containing all
+ * cpus is assumed. The replicas are placed with the first-touch policy, by
+ * copying the tables from threads bound to the cpus of each node. Returns the
+ * number of nodes.
+ */
+int init_numa_sampler(struct numa_sampler *ns, struct sampler *s) {
+  ns->cpuNum = NUMA_MAX_CPUS;
+  ns->cpu_node = malloc(ns->cpuNum * sizeof(int));
+  for (int cpu = 0; cpu < ns->cpuNum; cpu++) {
+    ns->cpu_node[cpu] = -1;
+  }
+
+  /* Find the nodes and their cpus */
+  ns->nodeNum = 0;
+  while (read_node_cpus(ns, ns->nodeNum) >= 0) {
+    ns->nodeNum++;
+  }
+  if (ns->nodeNum == 0) {
+    ns->nodeNum = 1;
+    for (int cpu = 0; cpu < ns->cpuNum; cpu++) {
+      ns->cpu_node[cpu] = 0;
+    }
+  }
+
+  /* Copy the tables onto each node */
+  ns->replicas = malloc(ns->nodeNum * sizeof(struct sampler));
+  for (int node = 0; node < ns->nodeNum; node++) {
+    struct replica_task task = {ns, s, node};
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, replicate_on_node, &task) == 0) {
+      pthread_join(thread, NULL);
+    } else {
+      copy_sampler(&ns->replicas[node], s);
+    }
+  }
+
+  return ns->nodeNum;
+}
+
+/**
+ * @brief Clean up the replicated tables
+ *
+ * @param ns The #numa_sampler to be cleaned
+ */
+void clean_numa_sampler(struct numa_sampler *ns) {
+  for (int node = 0; node < ns->nodeNum; node++) {
+    clean_sampler(&ns->replicas[node]);
+  }
+  free(ns->replicas);
+  free(ns->cpu_node);
+}
+
+/**
+ * @brief Get the replica on the node of the cpu that the calling thread runs
+ * on. Threads should be bound to a node for the result to stay local.
+ *
+ * @param ns The #numa_sampler
+ */
+struct sampler *numa_sampler_local(struct numa_sampler *ns) {
+  int cpu = sched_getcpu();
+  int node = (cpu >= 0 && cpu < ns->cpuNum) ? ns->cpu_node[cpu] : 0;
+  return &ns->replicas[node >= 0 ? node : 0];
+}
+
+/**
+ * @brief Bind the calling thread to the cpus of a node
+ *
+ * @param ns The #numa_sampler
+ * @param node The node
+ * @param k Bind to the k-th cpu of the node only, or to all cpus if negative
+ *
+ * Returns 0 on success.
+ */
+int numa_sampler_bind(struct numa_sampler *ns, int node, int k) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+
+  int count = 0;
+  for (int cpu = 0; cpu < ns->cpuNum && cpu < CPU_SETSIZE; cpu++) {
+    if (ns->cpu_node[cpu] == node) {
+      if (k < 0 || count == k) CPU_SET(cpu, &set);
+      count++;
+    }
+  }
+
+  if (CPU_COUNT(&set) == 0) return 1;
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set);
+}
+
+/**
+ * @brief Transform an array of uniform random numbers into custom variates in
+ * parallel, with every thread reading the tables on its own node
+ *
+ * @param ns The #numa_sampler for the distribution
+ * @param u Array of random numbers to be transformed
+ * @param x Output array of custom variates
+ * @param n Number of random numbers
+ *
+ * For the tables to be local, the OpenMP threads should be bound, e.g. with
+ * OMP_PROC_BIND=true.
+ */
+void draw_numa_sampler_batch(struct numa_sampler *ns, const double *u,
+                             double *x, long n) {
+#pragma omp parallel
+  {
+    struct sampler *s = numa_sampler_local(ns);
+
+#pragma omp for schedule(static)
+    for (long i = 0; i < n; i++) {
+      x[i] = draw_sampler(s, u[i]);
+    }
+  }
+}
@@ -0,0 +1,474 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <dlfcn.h>
+
+#include "../include/pdf_runtime.h"
+
+/* State of the recursive descent parser */
+struct expr_parser {
+  const char *source;
+  const char *pos;
+  struct pdf_expression *e;
+  int depth;
+  int failed;
+};
+
+static void parse_conditional(struct expr_parser *p);
+
+/* Record the first error encountered */
+static void parse_error(struct expr_parser *p, const char *msg) {
+  if (!p->failed) {
+    snprintf(p->e->error, sizeof(p->e->error), "%s at position %d", msg,
+             (int)(p->pos - p->source));
+    p->failed = 1;
+  }
+}
+
+/* Append an instruction and keep track of the stack depth */
+static void emit(struct expr_parser *p, enum expr_opcode op, int arg,
+                 double value, int pops, int pushes) {
+  struct pdf_expression *e = p->e;
+  if (p->failed) return;
+
+  e->code = realloc(e->code, (e->codeNum + 1) * sizeof(struct expr_instr));
+  e->code[e->codeNum].op = op;
+  e->code[e->codeNum].arg = arg;
+  e->code[e->codeNum].value = value;
+  e->codeNum++;
+
+  p->depth += pushes - pops;
+  if (p->depth > e->stackSize) e->stackSize = p->depth;
+  if (p->depth > EXPR_MAX_STACK) parse_error(p, "Expression too deep");
+}
+
+static void skip_space(struct expr_parser *p) {
+  while (isspace((unsigned char)*p->pos)) p->pos++;
+}
+
+/* Consume the token if it is next in the input */
+static int accept(struct expr_parser *p, const char *token) {
+  skip_space(p);
+  size_t len = strlen(token);
+  if (strncmp(p->pos, token, len) == 0) {
+    p->pos += len;
+    return 1;
+  }
+  return 0;
+}
+
+static void expect(struct expr_parser *p, const char *token) {
+  if (!accept(p, token)) {
+    char msg[32];
+    snprintf(msg, sizeof(msg), "Expected '%s'", token);
+    parse_error(p, msg);
+  }
+}
+
+/* Functions that can be used in expressions */
+static const struct {
+  const char *name;
+  enum expr_opcode op;
+  int args;
+} expr_functions[] = {
+    {"exp", EXPR_EXP, 1},   {"log", EXPR_LOG, 1}, {"sqrt", EXPR_SQRT, 1},
+    {"sin", EXPR_SIN, 1},   {"cos", EXPR_COS, 1}, {"abs", EXPR_ABS, 1},
+    {"pow", EXPR_POW, 2},   {"min", EXPR_MIN, 2}, {"max", EXPR_MAX, 2}};
+
+/* primary := number | x | p<i> | function(args) | (expression) */
+static void parse_primary(struct expr_parser *p) {
+  skip_space(p);
+  if (p->failed) return;
+
+  if (isdigit((unsigned char)*p->pos) || *p->pos == '.') {
+    char *end;
+    double value = strtod(p->pos, &end);
+    p->pos = end;
+    emit(p, EXPR_CONST, 0, value, 0, 1);
+  } else if (accept(p, "(")) {
+    parse_conditional(p);
+    expect(p, ")");
+  } else if (isalpha((unsigned char)*p->pos)) {
+    const char *start = p->pos;
+    while (isalnum((unsigned char)*p->pos) || *p->pos == '_') p->pos++;
+    size_t len = p->pos - start;
+
+    if (len == 1 && *start == 'x') {
+      emit(p, EXPR_X, 0, 0., 0, 1);
+      return;
+    } else if (*start == 'p' && len > 1 &&
+               strspn(start + 1, "0123456789") == len - 1) {
+      /* Parameters are p followed by digits only, e.g. not p1abc */
+      long i = strtol(start + 1, NULL, 10);
+      if (i >= p->e->paramNum) parse_error(p, "Unknown parameter");
+      emit(p, EXPR_PARAM, (int)i, 0., 0, 1);
+      return;
+    }
+
+    for (size_t j = 0; j < sizeof(expr_functions) / sizeof(expr_functions[0]);
+         j++) {
+      if (strlen(expr_functions[j].name) == len &&
+          strncmp(expr_functions[j].name, start, len) == 0) {
+        expect(p, "(");
+        parse_conditional(p);
+        if (expr_functions[j].args == 2) {
+          expect(p, ",");
+          parse_conditional(p);
+        }
+        expect(p, ")");
+        emit(p, expr_functions[j].op, 0, 0., expr_functions[j].args, 1);
+        return;
+      }
+    }
+    parse_error(p, "Unknown identifier");
+  } else {
+    parse_error(p, "Unexpected character");
+  }
+}
+
+static void parse_unary(struct expr_parser *p);
+
+/* power := primary [^ unary] */
+static void parse_power(struct expr_parser *p) {
+  parse_primary(p);
+  if (accept(p, "^")) {
+    parse_unary(p);
+    emit(p, EXPR_POW, 0, 0., 2, 1);
+  }
+}
+
+/* unary := -unary | power */
+static void parse_unary(struct expr_parser *p) {
+  if (accept(p, "-")) {
+    parse_unary(p);
+    emit(p, EXPR_NEG, 0, 0., 1, 1);
+  } else {
+    parse_power(p);
+  }
+}
+
+/* product := unary {(*|/) unary} */
+static void parse_product(struct expr_parser *p) {
+  parse_unary(p);
+  while (!p->failed) {
+    if (accept(p, "*")) {
+      parse_unary(p);
+      emit(p, EXPR_MUL, 0, 0., 2, 1);
+    } else if (accept(p, "/")) {
+      parse_unary(p);
+      emit(p, EXPR_DIV, 0, 0., 2, 1);
+    } else {
+      break;
+    }
+  }
+}
+
+/* sum := product {(+|-) product} */
+static void parse_sum(struct expr_parser *p) {
+  parse_product(p);
+  while (!p->failed) {
+    if (accept(p, "+")) {
+      parse_product(p);
+      emit(p, EXPR_ADD, 0, 0., 2, 1);
+    } else if (accept(p, "-")) {
+      parse_product(p);
+      emit(p, EXPR_SUB, 0, 0., 2, 1);
+    } else {
+      break;
+    }
+  }
+}
+
+/* comparison := sum [(<|<=|>|>=) sum] */
+static void parse_comparison(struct expr_parser *p) {
+  parse_sum(p);
+  enum expr_opcode op;
+  if (accept(p, "<=")) {
+    op = EXPR_LE;
+  } else if (accept(p, "<")) {
+    op = EXPR_LT;
+  } else if (accept(p, ">=")) {
+    op = EXPR_GE;
+  } else if (accept(p, ">")) {
+    op = EXPR_GT;
+  } else {
+    return;
+  }
+  parse_sum(p);
+  emit(p, op, 0, 0., 2, 1);
+}
+
+/* conditional := comparison [? conditional : conditional] */
+static void parse_conditional(struct expr_parser *p) {
+  parse_comparison(p);
+  if (accept(p, "?")) {
+    parse_conditional(p);
+    expect(p, ":");
+    parse_conditional(p);
+    emit(p, EXPR_SELECT, 0, 0., 3, 1);
+  }
+}
+
+/**
+ * @brief Compile a pdf given as an expression
+ *
+ * @param e The #pdf_expression to initialize
+ * @param source The expression, e.g. "x^2 / (exp((x - p1) / p0) + 1)"
+ * @param params Values of the parameters p0, p1, ...
+ * @param paramNum Number of parameters, at most EXPR_MAX_PARAMS
+ *
+ * Expressions may use the variable x, parameters p0, p1, ..., numbers, the
+ * operators + - * / ^, comparisons < <= > >= (evaluating to 0 or 1), the
+ * conditional c ? a : b, and the functions exp, log, sqrt, sin, cos, abs,
+ * pow, min and max. Returns 0 on success. Otherwise, e->error describes the
+ * problem and the expression must still be cleaned.
+ */
+int compile_pdf_expression(struct pdf_expression *e, const char *source,
+                           const double *params, int paramNum) {
+  e->code = NULL;
+  e->codeNum = 0;
+  e->stackSize = 0;
+  e->error[0] = '\0';
+  e->paramNum = paramNum < EXPR_MAX_PARAMS ? paramNum : EXPR_MAX_PARAMS;
+  for (int i = 0; i < e->paramNum; i++) {
+    e->params[i] = params[i];
+  }
+
+  struct expr_parser p = {source, source, e, 0, 0};
+  if (paramNum > EXPR_MAX_PARAMS) parse_error(&p, "Too many parameters");
+  parse_conditional(&p);
+  skip_space(&p);
+  if (*p.pos != '\0') parse_error(&p, "Unexpected character");
+
+  return p.failed;
+}
+
+/**
+ * @brief Clean up a compiled expression
+ *
+ * @param e The #pdf_expression to be cleaned
+ */
+void clean_pdf_expression(struct pdf_expression *e) {
+  free(e->code);
+  e->code = NULL;
+  e->codeNum = 0;
+}
+
+/**
+ * @brief Evaluate a compiled expression for an array of points
+ *
+ * @param x Array of points
+ * @param out Output array of pdf values
+ * @param n Number of points
+ * @param params Pointer to the #pdf_expression
+ *
+ * Every instruction is applied to a block of EXPR_BATCH_LENGTH points at a
+ * time, so that the interpreter overhead is amortized and the inner loops can
+ * be vectorized by the compiler.
+ */
+void eval_pdf_expression_batch(const double *x, double *out, size_t n,
+                               void *params) {
+  struct pdf_expression *e = (struct pdf_expression *)params;
+  double stack[e->stackSize > 0 ? e->stackSize : 1][EXPR_BATCH_LENGTH];
+
+  for (size_t start = 0; start < n; start += EXPR_BATCH_LENGTH) {
+    const double *xb = x + start;
+    int m = (n - start < EXPR_BATCH_LENGTH) ? n - start : EXPR_BATCH_LENGTH;
+    int top = -1;
+
+    for (int k = 0; k < e->codeNum; k++) {
+      const struct expr_instr *in = &e->code[k];
+      double *a = stack[top > 0 ? top - 1 : 0];
+      double *b = stack[top >= 0 ? top : 0];
+      double *c = stack[top > 1 ? top - 2 : 0];
+
+      switch (in->op) {
+        case EXPR_X:
+          top++;
+          memcpy(stack[top], xb, m * sizeof(double));
+          break;
+        case EXPR_PARAM:
+        case EXPR_CONST: {
+          double value = (in->op == EXPR_PARAM) ? e->params[in->arg]
+                                                 : in->value;
+          top++;
+          for (int i = 0; i < m; i++) stack[top][i] = value;
+          break;
+        }
+        case EXPR_ADD:
+          for (int i = 0; i < m; i++) a[i] += b[i];
+          top--;
+          break;
+        case EXPR_SUB:
+          for (int i = 0; i < m; i++) a[i] -= b[i];
+          top--;
+          break;
+        case EXPR_MUL:
+          for (int i = 0; i < m; i++) a[i] *= b[i];
+          top--;
+          break;
+        case EXPR_DIV:
+          for (int i = 0; i < m; i++) a[i] /= b[i];
+          top--;
+          break;
+        case EXPR_POW:
+          for (int i = 0; i < m; i++) a[i] = pow(a[i], b[i]);
+          top--;
+          break;
+        case EXPR_MIN:
+          for (int i = 0; i < m; i++) a[i] = fmin(a[i], b[i]);
+          top--;
+          break;
+        case EXPR_MAX:
+          for (int i = 0; i < m; i++) a[i] = fmax(a[i], b[i]);
+          top--;
+          break;
+        case EXPR_LT:
+          for (int i = 0; i < m; i++) a[i] = a[i] < b[i];
+          top--;
+          break;
+        case EXPR_LE:
+          for (int i = 0; i < m; i++) a[i] = a[i] <= b[i];
+          top--;
+          break;
+        case EXPR_GT:
+          for (int i = 0; i < m; i++) a[i] = a[i] > b[i];
+          top--;
+          break;
+        case EXPR_GE:
+          for (int i = 0; i < m; i++) a[i] = a[i] >= b[i];
+          top--;
+          break;
+        case EXPR_SELECT:
+          for (int i = 0; i < m; i++) c[i] = (c[i] != 0.) ? a[i] : b[i];
+          top -= 2;
+          break;
+        case EXPR_NEG:
+          for (int i = 0; i < m; i++) b[i] = -b[i];
+          break;
+        case EXPR_EXP:
+          for (int i = 0; i < m; i++) b[i] = exp(b[i]);
+          break;
+        case EXPR_LOG:
+          for (int i = 0; i < m; i++) b[i] = log(b[i]);
+          break;
+        case EXPR_SQRT:
+          for (int i = 0; i < m; i++) b[i] = sqrt(b[i]);
+          break;
+        case EXPR_SIN:
+          for (int i = 0; i < m; i++) b[i] = sin(b[i]);
+          break;
+        case EXPR_COS:
+          for (int i = 0; i < m; i++) b[i] = cos(b[i]);
+          break;
+        case EXPR_ABS:
+          for (int i = 0; i < m; i++) b[i] = fabs(b[i]);
+          break;
+      }
+    }
+
+    memcpy(out + start, stack[0], m * sizeof(double));
+  }
+}
+
+/**
+ * @brief Evaluate a compiled expression at a single point
+ *
+ * @param x The point at which to evaluate the pdf
+ * @param params Pointer to the #pdf_expression
+ *
+ * This function has the signature of a #pdf and can be passed directly to
+ * init_sampler, with the #pdf_expression as parameters.
+ */
+double eval_pdf_expression(double x, void *params) {
+  double out;
+  eval_pdf_expression_batch(&x, &out, 1, params);
+  return out;
+}
+
+/* Record the last error of the dynamic linker */
+static void plugin_error(struct pdf_plugin *p) {
+  const char *msg = dlerror();
+  snprintf(p->error, sizeof(p->error), "%s",
+           (msg != NULL) ? msg : "Symbol not found");
+}
+
+/**
+ * @brief Load a pdf and optionally its derivative from a shared object
+ *
+ * @param p The #pdf_plugin to initialize
+ * @param path Path to the shared object
+ * @param symbol Name of the pdf function, with the signature of a #pdf
+ * @param dsymbol Optional name of the derivative, can be NULL
+ *
+ * If the shared object also contains a function <symbol>_batch with the
+ * signature of a #pdf_batch, it is loaded as well and can be passed to
+ * init_sampler_batch. Returns 0 on success and 1 if the object or the symbols
+ * cannot be found, in which case the error is described in p->error.
+ */
+int load_pdf_plugin(struct pdf_plugin *p, const char *path,
+                    const char *symbol, const char *dsymbol) {
+  p->f = NULL;
+  p->df = NULL;
+  p->fb = NULL;
+  p->error[0] = '\0';
+  p->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+  if (p->handle == NULL) {
+    plugin_error(p);
+    return 1;
+  }
+
+  /* Casting through void* is the POSIX way of obtaining function pointers */
+  *(void **)(&p->f) = dlsym(p->handle, symbol);
+  if (dsymbol != NULL) {
+    *(void **)(&p->df) = dlsym(p->handle, dsymbol);
+  }
+
+  if (p->f == NULL || (dsymbol != NULL && p->df == NULL)) {
+    plugin_error(p);
+    close_pdf_plugin(p);
+    return 1;
+  }
+
+  /* Look for an optional batch version of the pdf */
+  char batch_symbol[256];
+  snprintf(batch_symbol, sizeof(batch_symbol), "%s_batch", symbol);
+  *(void **)(&p->fb) = dlsym(p->handle, batch_symbol);
+
+  return 0;
+}
+
+/**
+ * @brief Close a pdf plugin. Samplers using it can no longer be initialized
+ * or refined, but drawing from existing tables is unaffected.
+ *
+ * @param p The #pdf_plugin to be closed
+ */
+void close_pdf_plugin(struct pdf_plugin *p) {
+  if (p->handle != NULL) dlclose(p->handle);
+  p->handle = NULL;
+  p->f = NULL;
+  p->df = NULL;
+  p->fb = NULL;
+}
@@ -19,26 +19,20 @@
 
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
+#include <sys/mman.h>
 
 #include "../include/random.h"
 
-/* Generate standard normal variable with Box-Mueller */
-double sampleNorm(rng_state *state) {
-    /* Generate random integers */
-    const uint64_t A = rand_uint64(state);
-    const uint64_t B = rand_uint64(state);
-    const double RMax = (double) UINT64_MAX + 1;
+/* Size of a huge page in bytes */
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
 
-    /* Map the random integers to the open (!) unit interval */
-    const double u = ((double) A + 0.5) / RMax;
-    const double v = ((double) B + 0.5) / RMax;
+/* Tables smaller than this are covered by a typical first-level TLB with
+ * 64 entries of 4 kB and are not moved into huge pages */
+#define HUGE_PAGE_MIN_BYTES (256 * 1024)
 
-    /* Map to two Gaussians (the second is not used - inefficient) */
-    const double z0 = sqrt(-2 * log(u)) * cos(2 * M_PI * v);
-    //double z1 = sqrt(-2 * log(u)) * sin(2 * M_PI * v);
-
-    return z0;
-}
+/* Number of elements ahead for which memory is prefetched in batch draws */
+#define PREFETCH_DISTANCE 8
 
 /**
  * @brief Numerical evaluation of the cumulative distribution function
@@ -59,6 +53,63 @@ double numerical_cdf(double xl, double xr, pdf f, void *params) {
   return out;
 }
 
+/**
+ * @brief Numerical evaluation of the cumulative distribution function, using
+ * a batch version of the pdf
+ *
+ * @param xl Left endpoint of the integration
+ * @param xr Right endpoint of the integration
+ * @param fb Batch probability density function reference
+ * @param params Parameters for the distribution function
+ */
+double numerical_cdf_batch(double xl, double xr, pdf_batch fb, void *params) {
+  double x[NUMERICAL_CDF_SAMPLES];
+  double fx[NUMERICAL_CDF_SAMPLES];
+
+  /* Evaluate the pdf at all midpoints at once */
+  double delta = (xr - xl) / NUMERICAL_CDF_SAMPLES;
+  for (int i = 0; i < NUMERICAL_CDF_SAMPLES; i++) {
+    x[i] = xl + (i + 0.5) * delta;
+  }
+  fb(x, fx, NUMERICAL_CDF_SAMPLES, params);
+
+  /* Midpoint rule integration */
+  double out = 0.0;
+  for (int i = 0; i < NUMERICAL_CDF_SAMPLES; i++) {
+    out += delta * fx[i];
+  }
+  return out;
+}
+
+static void split_domain(struct sampler *s);
+static void release_hugepages(struct sampler *s);
+
+/* Integrate the pdf of the sampler, using the exact cdf or the batch pdf if
+ * available */
+static inline double sampler_integral(struct sampler *s, double xl,
+                                      double xr) {
+  if (s->cdf != NULL) {
+    return s->cdf(xr, s->params) - s->cdf(xl, s->params);
+  } else if (s->fb != NULL) {
+    return numerical_cdf_batch(xl, xr, s->fb, s->params);
+  } else {
+    return numerical_cdf(xl, xr, s->f, s->params);
+  }
+}
+
+/* Evaluate the pdf of the sampler at n points, using the batch pdf if
+ * available */
+static inline void sampler_eval_pdf(struct sampler *s, const double *x,
+                                    double *out, size_t n) {
+  if (s->fb != NULL) {
+    s->fb(x, out, n, s->params);
+  } else {
+    for (size_t i = 0; i < n; i++) {
+      out[i] = s->f(x[i], s->params);
+    }
+  }
+}
+
 /**
  * @brief Initialize the numerical inversion sampler.
  *
@@ -72,24 +123,116 @@ double numerical_cdf(double xl, double xr, pdf f, void *params) {
  *
  * We will compute Hermite polynomial approximations of the cdf F(X) in
  * discrete intervals, which are then used to quickly evaluate the inverse
- * transform X = F^-1(u) of a uniform random variate u.
+ * transform X = F^-1(u) of a uniform random variate u. Returns 0 on success
+ * and 1 if the tolerance could not be met everywhere (see refine_intervals),
+ * in which case the tables are still usable but less accurate.
+ */
+int init_sampler(struct sampler *s, pdf f, pdf df, double xl, double xr,
+                 double tol, void *params) {
+  return init_sampler_batch(s, f, NULL, df, xl, xr, tol, params);
+}
+
+/**
+ * @brief Initialize the numerical inversion sampler, using a batch version of
+ * the pdf during construction.
+ *
+ * @param s The #sampler to initialize
+ * @param pdf Function reference of the probability density function
+ * @param fb Optional batch version of the pdf, can be NULL
+ * @param df Optional function reference to derivative of pdf, can be NULL
+ * @param xl Left endpoint of the domain
+ * @param xr Right endpoint of the domain
+ * @param tol Tolerance for the Hermite interpolation
+ * @param params Parameters to be passed to the pdf
+ *
+ * The batch pdf, if given, must agree with f and is used for all evaluations
+ * during construction, which allows for vectorized implementations. Returns
+ * 0 on success and 1 if the tolerance could not be met everywhere.
  */
-void init_sampler(struct sampler *s, pdf f, pdf df, double xl, double xr,
-                  double tol, void *params) {
+int init_sampler_batch(struct sampler *s, pdf f, pdf_batch fb, pdf df,
+                       double xl, double xr, double tol, void *params) {
+  /* Normalize the pdf and create the initial intervals */
+  prepare_sampler(s, f, fb, df, xl, xr, tol, params);
+
+  /* Now calculate Hermite polynomials in intervals and split them up if
+   * they are not monotonic or if the error is too big. */
+  int err = refine_intervals(s, 0, tol);
+
+  /* Sort the intervals and generate the search table */
+  build_search_table(s);
+  return err;
+}
+
+/**
+ * @brief First phase of the initialization of the sampler: normalize the pdf
+ * and split the domain into intervals that cover at most 5% of the
+ * probability. The arguments are the same as for init_sampler_batch.
+ *
+ * The initial intervals are linked from left to right, starting with id 0.
+ * They are not yet fitted and the search tables are not yet generated.
+ */
+void prepare_sampler(struct sampler *s, pdf f, pdf_batch fb, pdf df,
+                     double xl, double xr, double tol, void *params) {
   /* Store the parameters and endpoints */
   s->xl = xl;
   s->xr = xr;
   s->f = f;
+  s->fb = fb;
   s->df = df;
+  s->cdf = NULL;
   s->tol = tol;
   s->params = params;
 
+  split_domain(s);
+}
+
+/**
+ * @brief Initialize the numerical inversion sampler for a distribution with
+ * a known cdf
+ *
+ * @param s The #sampler to initialize
+ * @param f Function reference of the probability density function
+ * @param cdf Function reference of the cdf, up to a constant and normalization
+ * @param df Optional function reference to derivative of pdf, can be NULL
+ * @param xl Left endpoint of the domain
+ * @param xr Right endpoint of the domain
+ * @param tol Tolerance for the Hermite interpolation
+ * @param params Parameters to be passed to the pdf and cdf
+ *
+ * The cdf replaces the numerical integration of the pdf, which otherwise
+ * takes up most of the construction time. Returns 0 on success and 1 if the
+ * tolerance could not be met everywhere.
+ */
+int init_sampler_cdf(struct sampler *s, pdf f, pdf cdf, pdf df, double xl,
+                     double xr, double tol, void *params) {
+  s->xl = xl;
+  s->xr = xr;
+  s->f = f;
+  s->fb = NULL;
+  s->df = df;
+  s->cdf = cdf;
+  s->tol = tol;
+  s->params = params;
+
+  split_domain(s);
+  int err = refine_intervals(s, 0, tol);
+  build_search_table(s);
+  return err;
+}
+
+/* Normalize the pdf and split the domain into linked intervals that cover at
+ * most 5% of the probability */
+static void split_domain(struct sampler *s) {
+  double xl = s->xl;
+  double xr = s->xr;
+
   /* Normalization of the pdf */
-  s->norm = 1.0 / numerical_cdf(xl, xr, f, params);
+  s->norm = 1.0 / sampler_integral(s, xl, xr);
 
   /* Create the intervals, starting with just one */
   s->intervalNum = 1;
   s->intervals = malloc(s->intervalNum * sizeof(struct interval));
+  s->index = NULL;
 
   /* Initially, the first interval covers the entire domain */
   s->intervals[0].id = 0;
@@ -97,6 +240,11 @@ void init_sampler(struct sampler *s, pdf f, pdf df, double xl, double xr,
   s->intervals[0].r = xr;
   s->intervals[0].Fl = 0.0;
   s->intervals[0].Fr = 1.0;
+  s->intervals[0].nid = -1;
+  s->intervals[0].error = -1.;
+  s->xindex = NULL;
+  s->table_memory = NULL;
+  s->table_mapped = 0;
 
   /* The current interval under consideration */
   int current_interval_id = 0;
@@ -108,11 +256,11 @@ void init_sampler(struct sampler *s, pdf f, pdf df, double xl, double xr,
     struct interval *iv = &s->intervals[current_interval_id];
 
     /* Check if the interval is too big (covers more than 5%) */
-    if (iv->Fr - iv->Fl > 0.05) {
-      /* Split the interval in half */
-      split_interval(s, current_interval_id);
-
-    } else if (iv->r >= xr) {
+    if (iv->Fr - iv->Fl > 0.05 &&
+        split_interval(s, current_interval_id) == 0) {
+      /* Continue with the left half */
+      continue;
+    } else if (iv->nid < 0) {
       /* Stop if we are at the end */
       done = 1;
     } else {
@@ -120,65 +268,152 @@ void init_sampler(struct sampler *s, pdf f, pdf df, double xl, double xr,
       current_interval_id = iv->nid;
     }
   }
+}
+
+/**
+ * @brief Calculate the Hermite polynomials in an interval and estimate the
+ * interpolation error at the midpoint
+ *
+ * @param s The #sampler containing the interval
+ * @param iv The #interval to be fitted
+ *
+ * The error is stored in iv->error and is infinite if the interpolation of
+ * the cdf is not monotonic.
+ */
+static void fit_interval(struct sampler *s, struct interval *iv) {
+  /* Evaluate the normalized pdf at the endpoints */
+  double x_lr[2] = {iv->l, iv->r};
+  double f_lr[2];
+  sampler_eval_pdf(s, x_lr, f_lr, 2);
+  double fl = s->norm * f_lr[0];
+  double fr = s->norm * f_lr[1];
 
-  /* Return to the first interval */
-  current_interval_id = 0;
+  /* Calculate the cubic Hermite approximation */
+  iv->a0 = iv->l;
+  iv->a1 = (iv->Fr - iv->Fl) / fl;
+  iv->a2 = 3 * (iv->r - iv->l) - (iv->Fr - iv->Fl) * (2. / fl + 1. / fr);
+  iv->a3 = 2 * (iv->l - iv->r) + (iv->Fr - iv->Fl) * (1. / fl + 1. / fr);
 
-  /* Now calculate Hermite polynomials in intervals and split them up if
-   * they are not monotonic or if the error is too big. */
-  done = 0;
+  /* Evaluate the error at the midpoint */
+  double u = 0.5 * (iv->Fr + iv->Fl);
+  double H = iv->a0 + iv->a1 * 0.5 + iv->a2 * 0.25 + iv->a3 * 0.125;
+  double error = fabs(s->norm * sampler_integral(s, s->xl, H) - u);
+
+  /* Monotonicity check */
+  double delta = (iv->Fr - iv->Fl) / (iv->r - iv->l);
+  char monotonic = (delta <= 3 * fl) && (delta <= 3 * fr);
+
+  /* If interpolation of the pdf is requested, do a second interpolation */
+  double pdf_error = 0.;
+  if (s->df != NULL) {
+      /* Evaluate derivatives of the normalized pdf at the endpoints */
+      double dfl = s->norm * s->df(iv->l, s->params) / fl;
+      double dfr = s->norm * s->df(iv->r, s->params) / fr;
+
+      /* Calculate the cubic Hermite approximation of the pdf */
+      iv->b0 = fl;
+      iv->b1 = (iv->Fr - iv->Fl) * dfl;
+      iv->b2 = 3 * (fr - fl) - (iv->Fr - iv->Fl) * (2. * dfl + 1. * dfr);
+      iv->b3 = 2 * (fl - fr) + (iv->Fr - iv->Fl) * (1. * dfl + 1. * dfr);
+
+      /* Evaluate the error in the pdf at the midpoint */
+      double fH = iv->b0 + iv->b1 * 0.5 + iv->b2 * 0.25 + iv->b3 * 0.125;
+      double f_H;
+      sampler_eval_pdf(s, &H, &f_H, 1);
+      pdf_error = fabs(s->norm * f_H - fH);
+  } else {
+      iv->b0 = 0.;
+      iv->b1 = 0.;
+      iv->b2 = 0.;
+      iv->b3 = 0.;
+  }
+
+  iv->error = monotonic ? fmax(error, pdf_error) : INFINITY;
+}
+
+/**
+ * @brief Replace the Hermite polynomials of an interval by linear
+ * interpolation, which keeps F^-1(u) inside the interval
+ *
+ * @param s The #sampler containing the interval
+ * @param iv The #interval to be fitted
+ *
+ * The error in u is then at most the probability of the interval. This is
+ * used for intervals whose probability is negligible, e.g. in far tails where
+ * the cdf differences are dominated by rounding errors and the Hermite
+ * interpolation is not monotonic no matter how often the interval is split.
+ */
+static void fit_interval_linear(struct sampler *s, struct interval *iv) {
+  double x_lr[2] = {iv->l, iv->r};
+  double f_lr[2];
+  sampler_eval_pdf(s, x_lr, f_lr, 2);
+
+  iv->a0 = iv->l;
+  iv->a1 = iv->r - iv->l;
+  iv->a2 = 0.;
+  iv->a3 = 0.;
+
+  if (s->df != NULL) {
+    iv->b0 = s->norm * f_lr[0];
+    iv->b1 = s->norm * (f_lr[1] - f_lr[0]);
+    iv->b2 = 0.;
+    iv->b3 = 0.;
+  }
+
+  iv->error = iv->Fr - iv->Fl;
+}
+
+/**
+ * @brief Fit Hermite polynomials in a chain of linked intervals, splitting
+ * intervals until the error is below the tolerance
+ *
+ * @param s The #sampler containing the intervals
+ * @param first_interval_id Id of the first interval of the chain
+ * @param tol Tolerance for the Hermite interpolation
+ *
+ * Intervals that were fitted before are not evaluated again, unless their
+ * error exceeds the tolerance. Intervals whose probability is below the
+ * tolerance are interpolated linearly if the Hermite interpolation is not
+ * monotonic.
+ * Splitting stops when an interval cannot be halved in double precision or
+ * when MAX_INTERVAL_NUM intervals exist, in which case the interval is kept
+ * with linear interpolation and 1 is returned. Returns 0 otherwise.
+ */
+int refine_intervals(struct sampler *s, int first_interval_id, double tol) {
+  int current_interval_id = first_interval_id;
+  int err = 0;
+
+  char done = 0;
   while (!done) {
     /* The interval under consideration */
     struct interval *iv = &s->intervals[current_interval_id];
 
-    /* Evaluate the normalized pdf at the endpoints */
-    double fl = s->norm * f(iv->l, params);
-    double fr = s->norm * f(iv->r, params);
-
-    /* Calculate the cubic Hermite approximation */
-    iv->a0 = iv->l;
-    iv->a1 = (iv->Fr - iv->Fl) / fl;
-    iv->a2 = 3 * (iv->r - iv->l) - (iv->Fr - iv->Fl) * (2. / fl + 1. / fr);
-    iv->a3 = 2 * (iv->l - iv->r) + (iv->Fr - iv->Fl) * (1. / fl + 1. / fr);
-
-    /* Evaluate the error at the midpoint */
-    double u = 0.5 * (iv->Fr + iv->Fl);
-    double H = iv->a0 + iv->a1 * 0.5 + iv->a2 * 0.25 + iv->a3 * 0.125;
-    double error = fabs(s->norm * numerical_cdf(xl, H, f, params) - u);
-
-    /* Monotonicity check */
-    double delta = (iv->Fr - iv->Fl) / (iv->r - iv->l);
-    char monotonic = (delta <= 3 * fl) && (delta <= 3 * fr);
-
-    /* If interpolation of the pdf is requested, do a second interpolation */
-    double pdf_error = 0.;
-    if (df != NULL) {
-        /* Evaluate derivatives of the normalized pdf at the endpoints */
-        double dfl = s->norm * df(iv->l, params) / fl;
-        double dfr = s->norm * df(iv->r, params) / fr;
-
-        /* Calculate the cubic Hermite approximation of the pdf */
-        iv->b0 = fl;
-        iv->b1 = (iv->Fr - iv->Fl) * dfl;
-        iv->b2 = 3 * (fr - fl) - (iv->Fr - iv->Fl) * (2. * dfl + 1. * dfr);
-        iv->b3 = 2 * (fl - fr) + (iv->Fr - iv->Fl) * (1. * dfl + 1. * dfr);
-
-        /* Evaluate the error in the pdf at the midpoint */
-        double fH = iv->b0 + iv->b1 * 0.5 + iv->b2 * 0.25 + iv->b3 * 0.125;
-        pdf_error = fabs(s->norm * f(H, params) - fH);
-    } else {
-        iv->b0 = 0.;
-        iv->b1 = 0.;
-        iv->b2 = 0.;
-        iv->b3 = 0.;
+    /* Fit the interval if this has not been done yet */
+    if (iv->error < 0.) {
+      fit_interval(s, iv);
+
+      /* Skip the monotonicity requirement for negligible probabilities */
+      if (!isfinite(iv->error) && iv->Fr - iv->Fl <= tol) {
+        fit_interval_linear(s, iv);
+      }
     }
 
+    /* Intervals that can no longer be split are kept as they are */
+    double m = iv->l + 0.5 * (iv->r - iv->l);
+    char splittable = (m > iv->l && m < iv->r &&
+                       s->intervalNum < MAX_INTERVAL_NUM);
+
     /* If the error is too big or if the polynomial is not monotonic */
-    if (error > tol || pdf_error > tol || !monotonic) {
-      /* Split the interval in half */
-      split_interval(s, current_interval_id);
+    if (!(iv->error <= tol) && splittable &&
+        split_interval(s, current_interval_id) == 0) {
+      /* Continue with the left half */
+      continue;
+    } else if (!(iv->error <= tol)) {
+      fit_interval_linear(s, iv);
+      err = 1;
+    }
 
-    } else if (iv->r >= xr) {
+    if (iv->nid < 0) {
       /* Stop if we are at the end */
       done = 1;
     } else {
@@ -187,27 +422,226 @@ void init_sampler(struct sampler *s, pdf f, pdf df, double xl, double xr,
     }
   }
 
+  return err;
+}
+
+/**
+ * @brief Sort the intervals, update the links, and generate the indexed
+ * search table
+ *
+ * @param s The #sampler containing the intervals
+ */
+void build_search_table(struct sampler *s) {
   /* Sort the intervals */
   qsort(s->intervals, s->intervalNum, sizeof(struct interval), compareByLeft);
 
+  /* Link the intervals in their new order */
+  for (int i = 0; i < s->intervalNum; i++) {
+    s->intervals[i].id = i;
+    s->intervals[i].nid = (i < s->intervalNum - 1) ? i + 1 : -1;
+  }
+
   /* Allocate memory for the search table */
-  s->index = (double *)malloc(SEARCH_TABLE_LENGTH * sizeof(double));
+  if (s->index == NULL) {
+    s->index = (double *)malloc(SEARCH_TABLE_LENGTH * sizeof(double));
+  }
 
   /* Generate the index search table */
   for (int i = 0; i < SEARCH_TABLE_LENGTH; i++) {
     double u = (double)i / SEARCH_TABLE_LENGTH;
 
-    /* Find the largest interval such that u > F(p) */
-    double maxJ = 0;
+    /* Find the largest interval such that u > F(p), which is the last one
+     * since the intervals are sorted */
     int int_i = 0;
     for (int j = 0; j < s->intervalNum; j++) {
-      if (s->intervals[j].Fr < u && s->intervals[j].r > maxJ) {
-        maxJ = s->intervals[j].r;
-        int_i = j;
-      }
+      if (s->intervals[j].Fr < u) int_i = j;
     }
     s->index[i] = int_i;
   }
+
+  /* Allocate memory for the search table in x */
+  if (s->xindex == NULL) {
+    s->xindex = (int *)malloc(SEARCH_TABLE_LENGTH * sizeof(int));
+  }
+
+  /* Generate the search table in x, i.e. the largest interval such that
+   * l <= x at the start of each bin */
+  int int_i = 0;
+  for (int i = 0; i < SEARCH_TABLE_LENGTH; i++) {
+    double x = s->xl + (s->xr - s->xl) * i / SEARCH_TABLE_LENGTH;
+    while (int_i < s->intervalNum - 1 && s->intervals[int_i + 1].l <= x) {
+      int_i++;
+    }
+    s->xindex[i] = int_i;
+  }
+}
+
+/**
+ * @brief Move the runtime tables of an initialized sampler into a single
+ * block of memory backed by 2 MB huge pages, to reduce TLB misses for large
+ * tables
+ *
+ * @param s The #sampler whose tables are moved
+ *
+ * Explicit huge pages (MAP_HUGETLB) are used if the system has reserved them.
+ * Otherwise, the block is aligned to 2 MB and transparent huge pages are
+ * requested with madvise. Tables smaller than HUGE_PAGE_MIN_BYTES are left
+ * in regular memory, since they do not cause TLB misses and most of the huge
+ * page would be wasted. Returns 0 if explicit huge pages were used and 1
+ * otherwise. The tables are moved back to regular memory if the sampler is
+ * refined or coarsened later.
+ */
+int sampler_use_hugepages(struct sampler *s) {
+  const size_t page = HUGE_PAGE_SIZE;
+  release_hugepages(s);
+
+  /* Layout of the block, with each table aligned to a cache line */
+  size_t intervals_bytes = s->intervalNum * sizeof(struct interval);
+  size_t index_bytes = SEARCH_TABLE_LENGTH * sizeof(double);
+  size_t index_offset = (intervals_bytes + 63) / 64 * 64;
+  size_t xindex_offset = index_offset + (index_bytes + 63) / 64 * 64;
+  size_t bytes = xindex_offset + SEARCH_TABLE_LENGTH * sizeof(int);
+  size_t rounded = (bytes + page - 1) / page * page;
+  if (bytes < HUGE_PAGE_MIN_BYTES) return 1;
+
+  /* Try explicit huge pages first */
+  int explicit_pages = 1;
+  char *block = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  block = mmap(NULL, rounded, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+
+  /* Fall back to transparent huge pages */
+  if (block == MAP_FAILED) {
+    explicit_pages = 0;
+    void *ptr;
+    if (posix_memalign(&ptr, page, rounded) != 0) return 1;
+    block = ptr;
+#ifdef MADV_HUGEPAGE
+    madvise(block, rounded, MADV_HUGEPAGE);
+#endif
+  }
+
+  /* Move the tables into the block */
+  memcpy(block, s->intervals, intervals_bytes);
+  memcpy(block + index_offset, s->index, index_bytes);
+  memcpy(block + xindex_offset, s->xindex, SEARCH_TABLE_LENGTH * sizeof(int));
+  free(s->intervals);
+  free(s->index);
+  free(s->xindex);
+
+  s->intervals = (struct interval *)block;
+  s->index = (double *)(block + index_offset);
+  s->xindex = (int *)(block + xindex_offset);
+  s->table_memory = block;
+  s->table_mapped = explicit_pages ? rounded : 0;
+
+  return !explicit_pages;
+}
+
+/**
+ * @brief Move the runtime tables back into separately allocated regular
+ * memory, if they were moved into huge pages
+ *
+ * @param s The #sampler whose tables are moved
+ */
+static void release_hugepages(struct sampler *s) {
+  if (s->table_memory == NULL) return;
+
+  struct sampler copy;
+  copy_sampler(&copy, s);
+  clean_sampler(s);
+  s->intervals = copy.intervals;
+  s->index = copy.index;
+  s->xindex = copy.xindex;
+  s->table_memory = NULL;
+  s->table_mapped = 0;
+}
+
+/**
+ * @brief Refine an initialized sampler to a smaller tolerance
+ *
+ * @param s The #sampler to refine
+ * @param tol The new tolerance for the Hermite interpolation
+ *
+ * Only intervals whose estimated error exceeds the new tolerance are split.
+ * The cdf values at existing endpoints are reused. The pdf and parameters of
+ * the sampler must still be valid. To keep sampling while refining, refine a
+ * copy (see copy_sampler) and publish it with live_sampler_swap. Returns 0 on
+ * success and 1 if the tolerance could not be met everywhere.
+ */
+int refine_sampler(struct sampler *s, double tol) {
+  release_hugepages(s);
+  s->tol = tol;
+  int err = refine_intervals(s, 0, tol);
+  build_search_table(s);
+  return err;
+}
+
+/* Check the error of a merged interval at the left endpoints of the original
+ * intervals first + 1, ..., last inside it, where the cdf is known */
+static int merged_error_below(struct sampler *s, const struct interval *iv,
+                              int first, int last, double tol) {
+  for (int j = first + 1; j <= last; j++) {
+    const struct interval *b = &s->intervals[j];
+    double t = (b->Fl - iv->Fl) / (iv->Fr - iv->Fl);
+    double H = hermite_cubic(iv->a0, iv->a1, iv->a2, iv->a3, t);
+    double error = fabs(s->norm * sampler_integral(s, b->l, H));
+    if (!(error <= tol)) return 0;
+  }
+  return 1;
+}
+
+/**
+ * @brief Coarsen an initialized sampler to a larger tolerance, by merging
+ * neighbouring intervals while the error stays below the tolerance
+ *
+ * @param s The #sampler to coarsen
+ * @param tol The new tolerance for the Hermite interpolation
+ *
+ * The cdf values at the remaining endpoints are reused. The pdf and
+ * parameters of the sampler must still be valid. A merged interval must
+ * meet the tolerance at its midpoint and at all the endpoints it replaces,
+ * and cover at most 5% of the probability. Returns 0 on success and 1 if
+ * memory could not be allocated, in which case the sampler is unchanged.
+ */
+int coarsen_sampler(struct sampler *s, double tol) {
+  struct interval *coarse = malloc(s->intervalNum * sizeof(struct interval));
+  if (coarse == NULL) return 1;
+
+  release_hugepages(s);
+  s->tol = tol;
+
+  /* Greedily merge intervals from left to right, where first is the first
+   * original interval covered by the last kept interval */
+  int kept = 0;
+  int first = 0;
+  for (int i = 0; i < s->intervalNum; i++) {
+    if (kept > 0) {
+      struct interval merged = coarse[kept - 1];
+      merged.r = s->intervals[i].r;
+      merged.Fr = s->intervals[i].Fr;
+
+      if (merged.Fr - merged.Fl <= 0.05) {
+        fit_interval(s, &merged);
+        if (merged.error <= tol &&
+            merged_error_below(s, &merged, first, i, tol)) {
+          coarse[kept - 1] = merged;
+          continue;
+        }
+      }
+    }
+    coarse[kept++] = s->intervals[i];
+    first = i;
+  }
+
+  free(s->intervals);
+  s->intervalNum = kept;
+  s->intervals = realloc(coarse, kept * sizeof(struct interval));
+  if (s->intervals == NULL) s->intervals = coarse;
+  build_search_table(s);
+  return 0;
 }
 
 /**
@@ -215,27 +649,30 @@ void init_sampler(struct sampler *s, pdf f, pdf df, double xl, double xr,
  *
  * @param s The #sampler containing the interval
  * @param current_interval_id Id of the interval to be split
+ *
+ * Returns 0 on success and 1 if the memory for the new interval could not be
+ * allocated, in which case the interval is left unchanged.
  */
-void split_interval(struct sampler *s, int current_interval_id) {
+int split_interval(struct sampler *s, int current_interval_id) {
   /* The current interval that will be halved */
   struct interval *iv = &s->intervals[current_interval_id];
 
-  /* Split the interval in half */
+  /* Split the interval in half, keeping the cdf non-decreasing in spite of
+   * rounding errors in the integration */
   double m = iv->l + 0.5 * (iv->r - iv->l);
-  double Fm = s->norm * numerical_cdf(s->xl, m, s->f, s->params);
+  double Fm = s->norm * sampler_integral(s, s->xl, m);
+  Fm = fmin(fmax(Fm, iv->Fl), iv->Fr);
+
+  /* Allocate memory for the new interval (inefficient, but not critical) */
+  struct interval *intervals =
+      realloc(s->intervals, (s->intervalNum + 1) * sizeof(struct interval));
+  if (intervals == NULL) return 1;
+  s->intervals = intervals;
 
   /* ID of the new interval */
   int id = s->intervalNum;
   s->intervalNum++;
 
-  /* Allocate memory for the new interval (inefficient, but not critical) */
-  s->intervals =
-      realloc(s->intervals, s->intervalNum * sizeof(struct interval));
-
-  if (s->intervals == NULL) {
-    // error("Error reallocating memory for the intervals.");
-  }
-
   /* Update the pointer to the current interval */
   iv = &s->intervals[current_interval_id];
 
@@ -247,10 +684,14 @@ void split_interval(struct sampler *s, int current_interval_id) {
   s->intervals[id].Fr = iv->Fr;
   s->intervals[id].nid = iv->nid;  // link to the old interval's right-neighbour
 
+  s->intervals[id].error = -1.;  // not yet fitted
+
   /* Update the old interval to cover just the left half */
   iv->r = m;
   iv->Fr = Fm;
   iv->nid = id;  // link the left-half to the right-half
+  iv->error = -1.;
+  return 0;
 }
 
 /**
@@ -259,8 +700,34 @@ void split_interval(struct sampler *s, int current_interval_id) {
  * @param s The #sampler to be cleaned
  */
 void clean_sampler(struct sampler *s) {
-  free(s->intervals);
-  free(s->index);
+  if (s->table_memory == NULL) {
+    free(s->intervals);
+    free(s->index);
+    free(s->xindex);
+  } else if (s->table_mapped > 0) {
+    munmap(s->table_memory, s->table_mapped);
+  } else {
+    free(s->table_memory);
+  }
+}
+
+/**
+ * @brief Make a deep copy of an initialized inversion sampler
+ *
+ * @param dst The #sampler to copy into
+ * @param src The #sampler to be copied
+ */
+void copy_sampler(struct sampler *dst, const struct sampler *src) {
+  *dst = *src;
+  dst->table_memory = NULL;
+  dst->table_mapped = 0;
+  dst->intervals = malloc(src->intervalNum * sizeof(struct interval));
+  dst->index = malloc(SEARCH_TABLE_LENGTH * sizeof(double));
+  dst->xindex = malloc(SEARCH_TABLE_LENGTH * sizeof(int));
+  memcpy(dst->intervals, src->intervals,
+         src->intervalNum * sizeof(struct interval));
+  memcpy(dst->index, src->index, SEARCH_TABLE_LENGTH * sizeof(double));
+  memcpy(dst->xindex, src->xindex, SEARCH_TABLE_LENGTH * sizeof(int));
 }
 
 /**
@@ -278,7 +745,7 @@ double draw_sampler(struct sampler *s, double u) {
 
     /* Find the exact interval, i.e. the largest interval such that u > F(p) */
     for (i = start; i < s->intervalNum-1; i++) {
-      if (s->intervals[i+1].Fr >= u) break;
+      if (s->intervals[i].Fr >= u) break;
     }
 
     /* The correct interval */
@@ -286,8 +753,7 @@ double draw_sampler(struct sampler *s, double u) {
 
     /* Evaluate F^-1(u) using the Hermite approximation of F in this interval */
     double u_tilde = (u - iv->Fl) / (iv->Fr - iv->Fl);
-    double H = iv->a0 + iv->a1 * u_tilde + iv->a2 * u_tilde * u_tilde +
-               iv->a3 * u_tilde * u_tilde * u_tilde;
+    double H = hermite_cubic(iv->a0, iv->a1, iv->a2, iv->a3, u_tilde);
 
     return H;
 }
@@ -307,7 +773,7 @@ double draw_pdf(struct sampler *s, double u) {
 
     /* Find the exact interval, i.e. the largest interval such that u > F(p) */
     for (i = start; i < s->intervalNum-1; i++) {
-      if (s->intervals[i+1].Fr >= u) break;
+      if (s->intervals[i].Fr >= u) break;
     }
 
     /* The correct interval */
@@ -315,8 +781,395 @@ double draw_pdf(struct sampler *s, double u) {
 
     /* Evaluate f(F^-1(u)) using the Hermite approximation of f */
     double u_tilde = (u - iv->Fl) / (iv->Fr - iv->Fl);
-    double H = iv->b0 + iv->b1 * u_tilde + iv->b2 * u_tilde * u_tilde +
-               iv->b3 * u_tilde * u_tilde * u_tilde;
+    double H = hermite_cubic(iv->b0, iv->b1, iv->b2, iv->b3, u_tilde);
 
   return H;
 }
+
+/* The range of intervals [lo, hi] that contains the first interval with
+ * F(r) >= u, from the search table entries of u and of the next value in the
+ * table. The range is exact except for rounding of u at the cell edges. */
+static inline void search_range(const struct sampler *s, double u, int *lo,
+                                int *hi) {
+  const int tablength = SEARCH_TABLE_LENGTH;
+  const int last = s->intervalNum - 1;
+  int int_u = (int)(u * tablength);
+  int k = int_u < tablength ? int_u : tablength - 1;
+  *lo = s->index[k];
+  *hi = (k + 1 < tablength) ? (int)s->index[k + 1] + 1 : last;
+  if (*hi > last) *hi = last;
+}
+
+/* Find the same interval as draw_sampler, i.e. the first interval with
+ * F(r) >= u, by bisection of the search range. This avoids the unpredictable
+ * branches and the many memory accesses of a linear search in large tables.
+ */
+static inline int bisect_interval(const struct sampler *s, double u) {
+  const int last = s->intervalNum - 1;
+  int lo, hi;
+  search_range(s, u, &lo, &hi);
+
+  /* Branch-free bisection, which the compiler turns into conditional moves */
+  int len = hi - lo + 1;
+  while (len > 1) {
+    int half = len / 2;
+    lo = (s->intervals[lo + half - 1].Fr < u) ? lo + half : lo;
+    len -= half;
+  }
+
+  /* Guard against rounding of u at the edges of the table cells */
+  while (lo < last && s->intervals[lo].Fr < u) lo++;
+  return lo;
+}
+
+/**
+ * @brief Transform an array of uniform random numbers into custom variates
+ *
+ * @param s The #sampler for the distribution
+ * @param u Array of random numbers to be transformed
+ * @param x Output array of custom variates
+ * @param n Number of random numbers
+ */
+void draw_sampler_batch(struct sampler *s, const double *u, double *x, int n) {
+  const int D = PREFETCH_DISTANCE;
+
+  /* The intervals found for the next D elements, indexed modulo D */
+  int found[PREFETCH_DISTANCE];
+
+  /* Software pipeline: the first interval probed by the search for element
+   * i + 2D is prefetched, the interval of element i + D is searched and
+   * prefetched, and element i is evaluated. This hides the memory latency of
+   * both the search and the evaluation for large tables. */
+  for (int i = -D; i < n; i++) {
+    if (i >= 0) {
+      struct interval *iv = &s->intervals[found[i % D]];
+      double u_tilde = (u[i] - iv->Fl) / (iv->Fr - iv->Fl);
+      x[i] = hermite_cubic(iv->a0, iv->a1, iv->a2, iv->a3, u_tilde);
+    }
+
+    if (i + D < n) {
+      int j = bisect_interval(s, u[i + D]);
+      const char *iv = (const char *)&s->intervals[j];
+      __builtin_prefetch(iv);
+      __builtin_prefetch(iv + 64);
+      found[(i + D) % D] = j;
+    }
+
+    if (i + 2 * D < n) {
+      int lo, hi;
+      search_range(s, u[i + 2 * D], &lo, &hi);
+      __builtin_prefetch(&s->intervals[lo + (hi - lo) / 2]);
+    }
+  }
+}
+
+/**
+ * @brief Find the interval containing x and solve H(t) = x for the Hermite
+ * approximation H of the quantile function in that interval
+ *
+ * @param s The #sampler for the distribution
+ * @param x Point inside the domain
+ * @param t Output, the solution t in [0, 1]
+ */
+static struct interval *locate_x(struct sampler *s, double x, double *t) {
+  /* Use the search table to find a nearby interval */
+  int tablength = SEARCH_TABLE_LENGTH;
+  int int_x = (int)((x - s->xl) / (s->xr - s->xl) * tablength);
+  int i = s->xindex[int_x < tablength ? int_x : tablength - 1];
+
+  /* Find the exact interval, i.e. the largest interval such that l <= x */
+  while (i < s->intervalNum - 1 && s->intervals[i + 1].l <= x) i++;
+  struct interval *iv = &s->intervals[i];
+
+  /* Solve H(t) = x with safeguarded Newton iterations, using that the
+   * Hermite polynomial is monotonic with H(0) = l and H(1) = r */
+  double tl = 0., tr = 1.;
+  double tt = (x - iv->l) / (iv->r - iv->l);
+  for (int it = 0; it < 50; it++) {
+    double H = iv->a0 + tt * (iv->a1 + tt * (iv->a2 + tt * iv->a3));
+    double dH = iv->a1 + tt * (2. * iv->a2 + tt * 3. * iv->a3);
+    if (H == x) break;
+
+    /* Update the bracket */
+    if (H < x) {
+      tl = tt;
+    } else {
+      tr = tt;
+    }
+
+    /* Take a Newton step, or bisect if it leaves the bracket */
+    double t_new = tt - (H - x) / dH;
+    if (!(t_new > tl && t_new < tr)) t_new = 0.5 * (tl + tr);
+    char converged = fabs(t_new - tt) < 1e-14;
+    tt = t_new;
+    if (converged) break;
+  }
+
+  *t = tt;
+  return iv;
+}
+
+/**
+ * @brief Evaluate the cdf F(x) from the tables, such that
+ * draw_sampler(s, F(x)) = x
+ *
+ * @param s The #sampler for the distribution
+ * @param x The point at which to evaluate the cdf
+ */
+double sampler_cdf(struct sampler *s, double x) {
+  if (x <= s->xl) return 0.;
+  if (x >= s->xr) return 1.;
+
+  double t;
+  struct interval *iv = locate_x(s, x, &t);
+  return iv->Fl + t * (iv->Fr - iv->Fl);
+}
+
+/**
+ * @brief Evaluate the normalized pdf f(x) from the tables, as the derivative
+ * of the cdf implied by the Hermite approximation of F^-1
+ *
+ * @param s The #sampler for the distribution
+ * @param x The point at which to evaluate the pdf
+ */
+double sampler_pdf(struct sampler *s, double x) {
+  if (x < s->xl || x > s->xr) return 0.;
+
+  double t;
+  struct interval *iv = locate_x(s, x, &t);
+  double dH = iv->a1 + t * (2. * iv->a2 + t * 3. * iv->a3);
+  return (iv->Fr - iv->Fl) / dH;
+}
+
+/**
+ * @brief Evaluate the cdf at an array of points
+ *
+ * @param s The #sampler for the distribution
+ * @param x Array of points
+ * @param F Output array of cdf values
+ * @param n Number of points
+ */
+void sampler_cdf_batch(struct sampler *s, const double *x, double *F, int n) {
+  for (int i = 0; i < n; i++) {
+    F[i] = sampler_cdf(s, x[i]);
+  }
+}
+
+/**
+ * @brief Evaluate the normalized pdf at an array of points
+ *
+ * @param s The #sampler for the distribution
+ * @param x Array of points
+ * @param f Output array of pdf values
+ * @param n Number of points
+ */
+void sampler_pdf_batch(struct sampler *s, const double *x, double *f, int n) {
+  for (int i = 0; i < n; i++) {
+    f[i] = sampler_pdf(s, x[i]);
+  }
+}
+
+/**
+ * @brief Prepare sampling from the distribution truncated to [a, b]
+ *
+ * The endpoints are clamped to the domain [xl, xr] of the sampler and F(a)
+ * and F(b) are evaluated once, so that draws with the resulting handle cost
+ * the same as untruncated draws.
+ *
+ * @param s The #sampler for the distribution
+ * @param t The #sampler_truncation to initialize
+ * @param a Left endpoint of the truncated domain
+ * @param b Right endpoint of the truncated domain
+ * @return 0 on success, 1 if a > b after clamping (or either is NaN), in
+ * which case draws with the handle return NaN
+ */
+int init_sampler_truncation(struct sampler *s, struct sampler_truncation *t,
+                            double a, double b) {
+  if (a < s->xl) a = s->xl;
+  if (b > s->xr) b = s->xr;
+
+  if (!(a <= b)) {
+    t->a = t->b = t->Fa = t->Fb = NAN;
+    return 1;
+  }
+
+  t->a = a;
+  t->b = b;
+  t->Fa = sampler_cdf(s, a);
+  t->Fb = sampler_cdf(s, b);
+  return 0;
+}
+
+/**
+ * @brief Transform a uniform random number into a variate from a truncated
+ * distribution prepared with init_sampler_truncation()
+ *
+ * @param s The #sampler for the distribution
+ * @param t The #sampler_truncation describing [a, b]
+ * @param u Random number to be transformed
+ */
+double draw_sampler_truncation(struct sampler *s,
+                               const struct sampler_truncation *t, double u) {
+  /* Propagate an invalid range instead of drawing from a reversed one */
+  if (!(t->a <= t->b)) return NAN;
+
+  /* Map the unit interval onto [F(a), F(b)] */
+  double X = draw_sampler(s, t->Fa + u * (t->Fb - t->Fa));
+
+  /* Guard against rounding errors at the endpoints */
+  return (X < t->a) ? t->a : (X > t->b) ? t->b : X;
+}
+
+/**
+ * @brief Transform an array of uniform random numbers into variates from a
+ * truncated distribution prepared with init_sampler_truncation()
+ *
+ * @param s The #sampler for the distribution
+ * @param t The #sampler_truncation describing [a, b]
+ * @param u Array of random numbers to be transformed
+ * @param x Output array of custom variates
+ * @param n Number of random numbers
+ */
+void draw_sampler_truncation_batch(struct sampler *s,
+                                   const struct sampler_truncation *t,
+                                   const double *u, double *x, int n) {
+  for (int i = 0; i < n; i++) {
+    x[i] = draw_sampler_truncation(s, t, u[i]);
+  }
+}
+
+/**
+ * @brief Transform a uniform random number into a variate from the
+ * distribution truncated to [a, b], without rebuilding the tables
+ *
+ * @param s The #sampler for the distribution
+ * @param a Left endpoint of the truncated domain
+ * @param b Right endpoint of the truncated domain
+ * @param u Random number to be transformed
+ * @return The variate, or NaN if a > b after clamping to [xl, xr]
+ *
+ * This evaluates F(a) and F(b) for every call. To sample many variates from
+ * the same truncated distribution, prepare a #sampler_truncation once with
+ * init_sampler_truncation() and use draw_sampler_truncation().
+ */
+double draw_sampler_truncated(struct sampler *s, double a, double b,
+                              double u) {
+  struct sampler_truncation t;
+  init_sampler_truncation(s, &t, a, b);
+  return draw_sampler_truncation(s, &t, u);
+}
+
+/**
+ * @brief Transform an array of uniform random numbers into variates from the
+ * distribution truncated to [a, b]
+ *
+ * @param s The #sampler for the distribution
+ * @param a Left endpoint of the truncated domain
+ * @param b Right endpoint of the truncated domain
+ * @param u Array of random numbers to be transformed
+ * @param x Output array of custom variates, all NaN if a > b after clamping
+ * to [xl, xr]
+ * @param n Number of random numbers
+ */
+void draw_sampler_truncated_batch(struct sampler *s, double a, double b,
+                                  const double *u, double *x, int n) {
+  struct sampler_truncation t;
+  init_sampler_truncation(s, &t, a, b);
+  draw_sampler_truncation_batch(s, &t, u, x, n);
+}
+
+/* Invert the sorted random numbers scale * u[k], moving a cursor forward
+ * from the interval of the previous element. The search table is only
+ * consulted when an element lies in a later cell of the table than the last
+ * lookup and beyond the current interval, i.e. for large jumps. */
+static void invert_sorted(struct sampler *s, const double *u, double scale,
+                          double *x, int n) {
+  const int tablength = SEARCH_TABLE_LENGTH;
+  const int last = s->intervalNum - 1;
+  double next_cell = 0.;
+  int i = 0;
+
+  for (int k = 0; k < n; k++) {
+    double v = u[k] * scale;
+
+    if (i < last && s->intervals[i].Fr < v) {
+      /* Skip ahead with the search table on a jump into a new cell */
+      if (v >= next_cell) {
+        int int_u = (int)(v * tablength);
+        int cell = int_u < tablength ? int_u : tablength - 1;
+        int start = s->index[cell];
+        if (start > i) i = start;
+        next_cell = (double)(cell + 1) / tablength;
+      }
+
+      /* Move the cursor to the interval containing v */
+      while (i < last && s->intervals[i].Fr < v) i++;
+    }
+
+    struct interval *iv = &s->intervals[i];
+    double u_tilde = (v - iv->Fl) / (iv->Fr - iv->Fl);
+    x[k] = hermite_cubic(iv->a0, iv->a1, iv->a2, iv->a3, u_tilde);
+  }
+}
+
+/**
+ * @brief Transform a non-decreasing array of uniform random numbers into
+ * custom variates, which are then also non-decreasing
+ *
+ * @param s The #sampler for the distribution
+ * @param u Array of sorted random numbers to be transformed
+ * @param x Output array of custom variates (may be the same as u)
+ * @param n Number of random numbers
+ */
+void draw_sampler_sorted_batch(struct sampler *s, const double *u, double *x,
+                               int n) {
+  invert_sorted(s, u, 1.0, x, n);
+}
+
+/**
+ * @brief Generate n custom variates in ascending order
+ *
+ * @param s The #sampler for the distribution
+ * @param state The random number generator state
+ * @param x Output array of sorted custom variates
+ * @param n Number of variates
+ *
+ * The sorted uniform random numbers are generated directly as normalized
+ * partial sums of n + 1 exponential spacings, which gives the same
+ * distribution as sorting n independent uniforms, in O(n) time.
+ */
+void draw_sampler_sorted(struct sampler *s, rng_state *state, double *x,
+                         int n) {
+  /* Partial sums of exponential variates */
+  double sum = 0.;
+  for (int k = 0; k < n; k++) {
+    sum -= log(sampleUniform(state));
+    x[k] = sum;
+  }
+  sum -= log(sampleUniform(state));
+
+  /* Normalize to the unit interval while inverting */
+  invert_sorted(s, x, 1.0 / sum, x, n);
+}
+
+/**
+ * @brief Generate n stratified custom variates in ascending order, with
+ * exactly one variate in each of the quantile ranges [k/n, (k+1)/n)
+ *
+ * @param s The #sampler for the distribution
+ * @param state The random number generator state
+ * @param x Output array of sorted custom variates
+ * @param n Number of variates
+ *
+ * The variates are not independent, but have a smaller sampling variance
+ * than independent variates for most statistics.
+ */
+void draw_sampler_stratified(struct sampler *s, rng_state *state, double *x,
+                             int n) {
+  const double inv_n = 1.0 / n;
+  for (int k = 0; k < n; k++) {
+    x[k] = (k + sampleUniform(state)) * inv_n;
+  }
+
+  draw_sampler_sorted_batch(s, x, x, n);
+}
@@ -0,0 +1,269 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../include/sampler2d.h"
+
+/* Parameters of the pdf of a conditional distribution or of the integrand of
+ * the marginal pdf */
+struct slice_params {
+  pdf2d f;
+  void *params;
+  double x;
+};
+
+/* The joint pdf as a function of y at fixed x */
+static double slice_pdf(double y, void *params) {
+  struct slice_params *sp = (struct slice_params *)params;
+  return sp->f(sp->x, y, sp->params);
+}
+
+/* The marginal pdf of x, integrated over y */
+static double marginal_pdf(double x, void *params) {
+  struct sampler2d *s2 = (struct sampler2d *)params;
+  struct slice_params sp = {s2->f, s2->params, x};
+  return numerical_cdf(s2->yl, s2->yr, slice_pdf, &sp);
+}
+
+/* Build a table for a one-dimensional pdf through a tabulation on a uniform
+ * grid, which provides an exact cdf to the builder. The tabulated pdf is
+ * only needed during construction and is not kept. Returns 0 on success
+ * and 1 if the pdf is not positive inside [a, b] or if the tolerance cannot
+ * be met, in which case the table is cleaned. */
+static int init_slice(struct sampler *s, pdf fn, void *params, double a,
+                      double b, double tol) {
+  const int m = SAMPLER2D_TABLE_POINTS;
+  double *x = malloc(m * sizeof(double));
+  double *f = malloc(m * sizeof(double));
+  if (x == NULL || f == NULL) {
+    free(x);
+    free(f);
+    return 1;
+  }
+  for (int i = 0; i < m; i++) {
+    x[i] = a + (b - a) * i / (m - 1);
+    f[i] = fn(x[i], params);
+  }
+
+  struct tabulated_pdf t;
+  int err = init_tabulated_pdf(&t, x, f, m);
+  free(x);
+  free(f);
+  if (err) return err;
+
+  err = init_sampler_tabulated(s, &t, tol);
+  clean_tabulated_pdf(&t);
+  s->f = NULL;
+  s->df = NULL;
+  s->cdf = NULL;
+  s->params = NULL;
+  if (err) clean_sampler(s);
+  return err;
+}
+
+/* Build the table for the conditional distribution of y at a given x */
+static int init_conditional(struct sampler2d *s2, struct sampler *s, double x,
+                            double tol) {
+  struct slice_params sp = {s2->f, s2->params, x};
+  return init_slice(s, slice_pdf, &sp, s2->yl, s2->yr, tol);
+}
+
+/* Quantile of y at fraction w between the conditional tables k and k + 1 */
+static inline double interpolate_quantile(struct sampler2d *s2, int k,
+                                          double w, double v) {
+  double y0 = draw_sampler(&s2->conditionals[k], v);
+  double y1 = draw_sampler(&s2->conditionals[k + 1], v);
+  return y0 + w * (y1 - y0);
+}
+
+/* Error in u of the quantile interpolation halfway between the conditional
+ * tables k and k + 1, measured with the table at the midpoint */
+static double interpolation_error(struct sampler2d *s2, int k,
+                                  struct sampler *mid) {
+  double error = 0.;
+  for (int j = 0; j < SAMPLER2D_PROBES; j++) {
+    double v = (j + 0.5) / SAMPLER2D_PROBES;
+    double y = interpolate_quantile(s2, k, 0.5, v);
+    error = fmax(error, fabs(sampler_cdf(mid, y) - v));
+  }
+  return error;
+}
+
+/**
+ * @brief Initialize a sampler for the joint distribution of (x, y)
+ *
+ * @param s2 The #sampler2d to initialize
+ * @param f Function reference of the joint probability density function
+ * @param xl Left endpoint of the domain in x
+ * @param xr Right endpoint of the domain in x
+ * @param yl Left endpoint of the domain in y
+ * @param yr Right endpoint of the domain in y
+ * @param tol Tolerance for the Hermite interpolation and for the
+ * interpolation between conditional tables
+ * @param params Parameters to be passed to the pdf
+ *
+ * The marginal pdf of x and the conditional pdfs of y are tabulated on
+ * SAMPLER2D_TABLE_POINTS points and interpolated with monotone splines, which
+ * limits the accuracy for pdfs that vary on smaller scales. Conditional tables
+ * are built on a grid of x that is refined until quantile interpolation
+ * between neighbouring tables reproduces the table at the midpoint to within
+ * tol. The pdf must be positive inside the domain. Returns 0 on success and
+ * 1 otherwise.
+ */
+int init_sampler2d(struct sampler2d *s2, pdf2d f, double xl, double xr,
+                   double yl, double yr, double tol, void *params) {
+  s2->f = f;
+  s2->params = params;
+  s2->xl = xl;
+  s2->xr = xr;
+  s2->yl = yl;
+  s2->yr = yr;
+
+  /* The marginal distribution of x */
+  if (init_slice(&s2->marginal, marginal_pdf, s2, xl, xr, tol)) return 1;
+
+  /* Initial uniform grid of conditional tables */
+  int capacity = 2 * SAMPLER2D_INITIAL_GRID;
+  s2->gridNum = 0;
+  s2->grid = malloc(capacity * sizeof(double));
+  s2->conditionals = malloc(capacity * sizeof(struct sampler));
+  if (s2->grid == NULL || s2->conditionals == NULL) {
+    clean_sampler2d(s2);
+    return 1;
+  }
+  for (int k = 0; k < SAMPLER2D_INITIAL_GRID; k++) {
+    s2->grid[k] = xl + (xr - xl) * k / (SAMPLER2D_INITIAL_GRID - 1);
+    if (init_conditional(s2, &s2->conditionals[k], s2->grid[k], tol)) {
+      clean_sampler2d(s2);
+      return 1;
+    }
+    s2->gridNum++;
+  }
+
+  /* Refine the grid from left to right, inserting midpoints where the
+   * interpolation between neighbouring tables is not accurate enough */
+  int k = 0;
+  while (k < s2->gridNum - 1) {
+    double x_mid = 0.5 * (s2->grid[k] + s2->grid[k + 1]);
+    struct sampler mid;
+    if (init_conditional(s2, &mid, x_mid, tol)) {
+      clean_sampler2d(s2);
+      return 1;
+    }
+
+    if (interpolation_error(s2, k, &mid) <= tol ||
+        s2->gridNum == SAMPLER2D_MAX_GRID) {
+      clean_sampler(&mid);
+      k++;
+      continue;
+    }
+
+    /* Insert the midpoint and check the left half again */
+    if (s2->gridNum == capacity) {
+      capacity *= 2;
+      double *grid = realloc(s2->grid, capacity * sizeof(double));
+      if (grid != NULL) s2->grid = grid;
+      struct sampler *conditionals =
+          realloc(s2->conditionals, capacity * sizeof(struct sampler));
+      if (conditionals != NULL) s2->conditionals = conditionals;
+      if (grid == NULL || conditionals == NULL) {
+        clean_sampler(&mid);
+        clean_sampler2d(s2);
+        return 1;
+      }
+    }
+    int tail = s2->gridNum - (k + 1);
+    memmove(&s2->grid[k + 2], &s2->grid[k + 1], tail * sizeof(double));
+    memmove(&s2->conditionals[k + 2], &s2->conditionals[k + 1],
+            tail * sizeof(struct sampler));
+    s2->grid[k + 1] = x_mid;
+    s2->conditionals[k + 1] = mid;
+    s2->gridNum++;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Free the memory of the marginal and conditional tables
+ *
+ * @param s2 The #sampler2d to clean
+ */
+void clean_sampler2d(struct sampler2d *s2) {
+  clean_sampler(&s2->marginal);
+  for (int k = 0; k < s2->gridNum; k++) {
+    clean_sampler(&s2->conditionals[k]);
+  }
+  free(s2->conditionals);
+  free(s2->grid);
+}
+
+/**
+ * @brief Transform two uniform random numbers into a pair of variates (x, y)
+ *
+ * @param s2 The #sampler2d for the distribution
+ * @param u Random number to be transformed into x
+ * @param v Random number to be transformed into y
+ * @param x Output variate x
+ * @param y Output variate y
+ *
+ * The conditional quantile of y is interpolated linearly in x between the
+ * two neighbouring tables, using the same random number for both.
+ */
+void draw_sampler2d(struct sampler2d *s2, double u, double v, double *x,
+                    double *y) {
+  double X = draw_sampler(&s2->marginal, u);
+
+  /* Find the grid cell containing x */
+  int lo = 0;
+  int hi = s2->gridNum - 1;
+  while (hi - lo > 1) {
+    int mid = (lo + hi) / 2;
+    if (s2->grid[mid] <= X) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+
+  double w = (X - s2->grid[lo]) / (s2->grid[lo + 1] - s2->grid[lo]);
+  *x = X;
+  *y = interpolate_quantile(s2, lo, w, v);
+}
+
+/**
+ * @brief Transform arrays of uniform random numbers into pairs of variates
+ *
+ * @param s2 The #sampler2d for the distribution
+ * @param u Array of random numbers to be transformed into x
+ * @param v Array of random numbers to be transformed into y
+ * @param x Output array of variates x
+ * @param y Output array of variates y
+ * @param n Number of pairs
+ */
+void draw_sampler2d_batch(struct sampler2d *s2, const double *u,
+                          const double *v, double *x, double *y, int n) {
+  for (int i = 0; i < n; i++) {
+    draw_sampler2d(s2, u[i], v[i], &x[i], &y[i]);
+  }
+}
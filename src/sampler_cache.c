@@ -0,0 +1,388 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../include/sampler_cache.h"
+
+#define SAMPLER_FILE_MAGIC 0x474e5259524e41ULL  // "ANYRNG"
+
+/* Version of the file layout, to be increased whenever it changes. Files are
+ * also rejected if the size of the interval struct differs, e.g. when they
+ * were written by a build for another architecture. */
+#define SAMPLER_FILE_VERSION 2
+
+/* 64-bit FNV-1a hash, continuing from a previous hash value */
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t size) {
+  const unsigned char *bytes = (const unsigned char *)data;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+/**
+ * @brief Initialize a sampler cache
+ *
+ * @param c The #sampler_cache to initialize
+ * @param capacity Maximum number of samplers kept in memory
+ * @param dir Optional directory for serialized tables, can be NULL
+ */
+void init_sampler_cache(struct sampler_cache *c, int capacity,
+                        const char *dir) {
+  c->capacity = capacity;
+  c->entryNum = 0;
+  c->clock = 0;
+  c->entries = malloc(capacity * sizeof(struct cache_entry));
+  c->dir = (dir != NULL) ? strdup(dir) : NULL;
+}
+
+/* Free the memory associated with a cache entry */
+static void clean_cache_entry(struct cache_entry *e) {
+  free(e->name);
+  free(e->params);
+  clean_sampler(&e->s);
+}
+
+/**
+ * @brief Clean up the sampler cache and all cached samplers
+ *
+ * @param c The #sampler_cache to be cleaned
+ */
+void clean_sampler_cache(struct sampler_cache *c) {
+  for (int i = 0; i < c->entryNum; i++) {
+    clean_cache_entry(&c->entries[i]);
+  }
+  free(c->entries);
+  free(c->dir);
+}
+
+/* Check whether a cache entry matches the requested key */
+static int entry_matches(const struct cache_entry *e, uint64_t hash,
+                         const char *name, pdf f, pdf df, double xl,
+                         double xr, double tol, const void *params,
+                         size_t params_size) {
+  if (e->hash != hash || e->params_size != params_size) return 0;
+  if (e->s.xl != xl || e->s.xr != xr || e->s.tol != tol) return 0;
+  if ((e->df != NULL) != (df != NULL)) return 0;
+  if (params_size > 0 && memcmp(e->params, params, params_size) != 0)
+    return 0;
+  if (name != NULL) {
+    return e->name != NULL && strcmp(e->name, name) == 0;
+  } else {
+    return e->name == NULL && e->f == f && e->df == df;
+  }
+}
+
+/* Insert a copy of the sampler into the cache, evicting the least recently
+ * used sampler if the cache is full */
+static void insert_entry(struct sampler_cache *c, const struct sampler *s,
+                         uint64_t hash, const char *name, pdf f, pdf df,
+                         const void *params, size_t params_size) {
+  if (c->capacity <= 0) return;
+
+  struct cache_entry *e;
+  if (c->entryNum < c->capacity) {
+    e = &c->entries[c->entryNum++];
+  } else {
+    e = &c->entries[0];
+    for (int i = 1; i < c->entryNum; i++) {
+      if (c->entries[i].last_use < e->last_use) e = &c->entries[i];
+    }
+    clean_cache_entry(e);
+  }
+
+  e->hash = hash;
+  e->name = (name != NULL) ? strdup(name) : NULL;
+  e->f = f;
+  e->df = df;
+  e->params_size = params_size;
+  e->params = malloc(params_size > 0 ? params_size : 1);
+  memcpy(e->params, params, params_size);
+  e->last_use = ++c->clock;
+  copy_sampler(&e->s, s);
+}
+
+/* Read a string of bytes preceded by its size from a file and compare it with
+ * the expected bytes */
+static int read_bytes_match(FILE *file, const void *data, size_t size) {
+  size_t stored_size;
+  if (fread(&stored_size, sizeof(size_t), 1, file) != 1) return 0;
+  if (stored_size != size) return 0;
+  if (size == 0) return 1;
+
+  char *stored = malloc(size);
+  if (stored == NULL) return 0;
+  int match = (fread(stored, 1, size, file) == size &&
+               memcmp(stored, data, size) == 0);
+  free(stored);
+  return match;
+}
+
+/* Check that the key at the start of a cache file matches the requested pdf
+ * name and parameters */
+static int read_key_matches(FILE *file, const char *name, const void *params,
+                            size_t params_size) {
+  return read_bytes_match(file, name, strlen(name)) &&
+         read_bytes_match(file, params, params_size);
+}
+
+/**
+ * @brief Initialize a sampler, reusing previously computed tables if the same
+ * pdf, parameters, domain and tolerance were requested before.
+ *
+ * @param c The #sampler_cache
+ * @param s The #sampler to initialize
+ * @param name Name identifying the pdf, or NULL to identify it by pointer
+ * @param f Function reference of the probability density function
+ * @param df Optional function reference to derivative of pdf, can be NULL
+ * @param xl Left endpoint of the domain
+ * @param xr Right endpoint of the domain
+ * @param tol Tolerance for the Hermite interpolation
+ * @param params Parameters to be passed to the pdf
+ * @param params_size Size of the parameters in bytes
+ *
+ * The pdf must be a pure function of x and the parameter bytes. The on-disk
+ * cache is only used for named pdfs, since function pointers differ between
+ * executables. Returns 0 if the tables were computed, 1 if they were found in
+ * memory and 2 if they were read from disk. If the computed tables do not
+ * meet the tolerance everywhere (see init_sampler), they are neither cached
+ * nor written to disk and -1 is returned, while the sampler can still be used.
+ * The sampler must be cleaned with clean_sampler as usual. The cache is not
+ * thread-safe.
+ */
+int cached_init_sampler(struct sampler_cache *c, struct sampler *s,
+                        const char *name, pdf f, pdf df, double xl, double xr,
+                        double tol, void *params, size_t params_size) {
+  /* Compute the hash of the key */
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  char has_df = (df != NULL);
+  if (name != NULL) {
+    hash = fnv1a(hash, name, strlen(name));
+  } else {
+    hash = fnv1a(hash, &f, sizeof(pdf));
+    hash = fnv1a(hash, &df, sizeof(pdf));
+  }
+  hash = fnv1a(hash, &has_df, sizeof(char));
+  hash = fnv1a(hash, params, params_size);
+  hash = fnv1a(hash, &xl, sizeof(double));
+  hash = fnv1a(hash, &xr, sizeof(double));
+  hash = fnv1a(hash, &tol, sizeof(double));
+
+  /* Look for the sampler in memory */
+  for (int i = 0; i < c->entryNum; i++) {
+    struct cache_entry *e = &c->entries[i];
+    if (entry_matches(e, hash, name, f, df, xl, xr, tol, params,
+                      params_size)) {
+      e->last_use = ++c->clock;
+      copy_sampler(s, &e->s);
+      s->f = f;
+      s->df = df;
+      s->params = params;
+      return 1;
+    }
+  }
+
+  /* Look for the sampler on disk */
+  char fname[4096];
+  int use_disk = (c->dir != NULL && name != NULL);
+  if (use_disk) {
+    snprintf(fname, sizeof(fname), "%s/%016llx.anyrng", c->dir,
+             (unsigned long long)hash);
+    FILE *file = fopen(fname, "rb");
+    if (file != NULL) {
+      /* The file starts with the name and parameter bytes, to rule out
+       * collisions of the hash */
+      int found = 0;
+      if (read_key_matches(file, name, params, params_size) &&
+          load_sampler(s, file) == 0) {
+        found = (s->xl == xl && s->xr == xr && s->tol == tol);
+        if (!found) clean_sampler(s);
+      }
+      fclose(file);
+
+      if (found) {
+        s->f = f;
+        s->df = df;
+        s->params = params;
+        insert_entry(c, s, hash, name, f, df, params, params_size);
+        return 2;
+      }
+    }
+  }
+
+  /* Compute the tables, which are only kept if they meet the tolerance */
+  if (init_sampler(s, f, df, xl, xr, tol, params) != 0) return -1;
+  insert_entry(c, s, hash, name, f, df, params, params_size);
+
+  if (use_disk) {
+    FILE *file = fopen(fname, "wb");
+    if (file != NULL) {
+      size_t name_size = strlen(name);
+      fwrite(&name_size, sizeof(size_t), 1, file);
+      fwrite(name, 1, name_size, file);
+      fwrite(&params_size, sizeof(size_t), 1, file);
+      fwrite(params, 1, params_size, file);
+      int failed = save_sampler(s, file);
+      if (fclose(file) != 0 || failed) remove(fname);
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Write the tables of an initialized sampler to a binary file
+ *
+ * @param s The #sampler to be written
+ * @param f The file to write to
+ *
+ * The pdf and its parameters are not written. Returns 0 on success.
+ */
+int save_sampler(const struct sampler *s, FILE *f) {
+  uint64_t magic = SAMPLER_FILE_MAGIC;
+  uint32_t version = SAMPLER_FILE_VERSION;
+  uint32_t interval_size = sizeof(struct interval);
+  char has_df = (s->df != NULL);
+  size_t written = 0;
+  written += fwrite(&magic, sizeof(uint64_t), 1, f);
+  written += fwrite(&version, sizeof(uint32_t), 1, f);
+  written += fwrite(&interval_size, sizeof(uint32_t), 1, f);
+  written += fwrite(&s->norm, sizeof(double), 1, f);
+  written += fwrite(&s->xl, sizeof(double), 1, f);
+  written += fwrite(&s->xr, sizeof(double), 1, f);
+  written += fwrite(&s->tol, sizeof(double), 1, f);
+  written += fwrite(&has_df, sizeof(char), 1, f);
+  written += fwrite(&s->intervalNum, sizeof(int), 1, f);
+  written += fwrite(s->intervals, sizeof(struct interval), s->intervalNum, f);
+  written += fwrite(s->index, sizeof(double), SEARCH_TABLE_LENGTH, f);
+  written += fwrite(s->xindex, sizeof(int), SEARCH_TABLE_LENGTH, f);
+  return written == 9 + s->intervalNum + 2 * SEARCH_TABLE_LENGTH ? 0 : 1;
+}
+
+/* Check that loaded tables can be used without reading out of bounds: the
+ * intervals must be finite, sorted and contiguous with valid links, and the
+ * search tables must contain interval indices */
+static int tables_valid(const struct sampler *s) {
+  const int n = s->intervalNum;
+  if (!(s->xl < s->xr)) return 0;
+
+  for (int i = 0; i < n; i++) {
+    const struct interval *iv = &s->intervals[i];
+    if (!isfinite(iv->l) || !isfinite(iv->r) || !isfinite(iv->Fl) ||
+        !isfinite(iv->Fr) || !isfinite(iv->a0) || !isfinite(iv->a1) ||
+        !isfinite(iv->a2) || !isfinite(iv->a3) || !isfinite(iv->b0) ||
+        !isfinite(iv->b1) || !isfinite(iv->b2) || !isfinite(iv->b3)) {
+      return 0;
+    }
+    if (!(iv->l < iv->r) || !(iv->Fl <= iv->Fr)) return 0;
+    if (iv->nid != -1 && (iv->nid < 0 || iv->nid >= n)) return 0;
+
+    /* Neighbouring intervals share their endpoints */
+    if (i > 0 && (iv->l != iv[-1].r || iv->Fl != iv[-1].Fr)) return 0;
+  }
+  if (s->intervals[0].l != s->xl || s->intervals[n - 1].r != s->xr) return 0;
+
+  for (int k = 0; k < SEARCH_TABLE_LENGTH; k++) {
+    double i = s->index[k];
+    if (!(i >= 0 && i < n && i == floor(i))) return 0;
+    if (s->xindex[k] < 0 || s->xindex[k] >= n) return 0;
+  }
+  return 1;
+}
+
+/**
+ * @brief Read the tables of a sampler written with save_sampler
+ *
+ * @param s The #sampler to initialize
+ * @param f The file to read from
+ *
+ * The pdf, its derivative and the parameters are set to NULL and can be set
+ * by the caller. Files written by another version of the library or on an
+ * architecture with a different layout of the tables are rejected, as are
+ * files that are too short for the number of intervals they announce or
+ * whose tables are inconsistent, e.g. with search table entries that are not
+ * interval indices. Returns 0 on success.
+ */
+int load_sampler(struct sampler *s, FILE *f) {
+  uint64_t magic;
+  uint32_t version, interval_size;
+  char has_df;  // not used, the caller knows whether df was given
+  size_t read = 0;
+  read += fread(&magic, sizeof(uint64_t), 1, f);
+  read += fread(&version, sizeof(uint32_t), 1, f);
+  read += fread(&interval_size, sizeof(uint32_t), 1, f);
+  if (read != 3 || magic != SAMPLER_FILE_MAGIC ||
+      version != SAMPLER_FILE_VERSION ||
+      interval_size != sizeof(struct interval)) {
+    return 1;
+  }
+
+  read = fread(&s->norm, sizeof(double), 1, f);
+  read += fread(&s->xl, sizeof(double), 1, f);
+  read += fread(&s->xr, sizeof(double), 1, f);
+  read += fread(&s->tol, sizeof(double), 1, f);
+  read += fread(&has_df, sizeof(char), 1, f);
+  read += fread(&s->intervalNum, sizeof(int), 1, f);
+  if (read != 6 || s->intervalNum <= 0 ||
+      s->intervalNum > MAX_INTERVAL_NUM) {
+    return 1;
+  }
+
+  /* Do not allocate more memory than the rest of the file can fill */
+  size_t table_size = s->intervalNum * sizeof(struct interval) +
+                      SEARCH_TABLE_LENGTH * (sizeof(double) + sizeof(int));
+  long pos = ftell(f);
+  if (pos >= 0 && fseek(f, 0, SEEK_END) == 0) {
+    long end = ftell(f);
+    if (fseek(f, pos, SEEK_SET) != 0 || end < pos ||
+        (size_t)(end - pos) < table_size) {
+      return 1;
+    }
+  }
+
+  s->f = NULL;
+  s->fb = NULL;
+  s->df = NULL;
+  s->cdf = NULL;
+  s->params = NULL;
+  s->intervals = malloc(s->intervalNum * sizeof(struct interval));
+  s->index = malloc(SEARCH_TABLE_LENGTH * sizeof(double));
+  s->xindex = malloc(SEARCH_TABLE_LENGTH * sizeof(int));
+  s->table_memory = NULL;
+  s->table_mapped = 0;
+  if (s->intervals == NULL || s->index == NULL || s->xindex == NULL) {
+    clean_sampler(s);
+    return 1;
+  }
+
+  read = fread(s->intervals, sizeof(struct interval), s->intervalNum, f);
+  read += fread(s->index, sizeof(double), SEARCH_TABLE_LENGTH, f);
+  read += fread(s->xindex, sizeof(int), SEARCH_TABLE_LENGTH, f);
+  if (read != (size_t)s->intervalNum + 2 * SEARCH_TABLE_LENGTH ||
+      !tables_valid(s)) {
+    clean_sampler(s);
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,278 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "../include/sampler_compressed.h"
+
+/* Distance in elements at which the batch draw prefetches the tables */
+#define PREFETCH_DISTANCE 8
+
+/**
+ * @brief Choose the scale factor that maps the largest magnitude onto the
+ * largest representable integer
+ *
+ * @param max_abs Largest absolute value to be encoded
+ * @param max_int Largest representable integer
+ */
+static double choose_scale(double max_abs, double max_int) {
+  return (max_abs > 0.) ? max_abs / max_int : 0.;
+}
+
+/**
+ * @brief Encode a value as a rounded integer multiple of the scale factor
+ *
+ * @param value The value to be encoded
+ * @param scale The scale factor
+ * @param max_int Largest representable integer, the result is clamped to
+ * [-max_int, max_int]. Offsets that are encoded as unsigned integers are
+ * never negative.
+ */
+static double quantize(double value, double scale, double max_int) {
+  if (scale == 0.) return 0.;
+  double q = round(value / scale);
+  return (q > max_int) ? max_int : (q < -max_int) ? -max_int : q;
+}
+
+/**
+ * @brief Encode the tables of a double-precision #sampler and check the
+ * error added by the compression.
+ *
+ * @param sc The #sampler_compressed to fill
+ * @param s The initialized #sampler to copy the tables from
+ * @param tol Tolerance for the error added by the compression
+ *
+ * The scale factors are chosen per block of COMPRESSED_BLOCK_SIZE intervals,
+ * such that each block uses the full range of the integers. The cdf and the
+ * left endpoints increase, so they are stored as unsigned offsets from the
+ * first interval in the block. The added error
+ * is measured in u, relative to the cdf implied by the tables of s. Returns
+ * the maximum error if it exceeds tol and 0 otherwise. In both cases, the
+ * compressed tables are usable and must be cleaned.
+ */
+double compress_sampler(struct sampler_compressed *sc, struct sampler *s,
+                        double tol) {
+  const int N = s->intervalNum;
+  const int blockNum = N / COMPRESSED_BLOCK_SIZE + 1;
+
+  sc->intervalNum = N;
+  sc->intervals = malloc((N + 1) * sizeof(struct compressed_interval));
+  sc->blocks = malloc(blockNum * sizeof(struct compressed_block));
+  sc->index = malloc(SEARCH_TABLE_LENGTH * sizeof(int));
+
+  for (int b = 0; b < blockNum; b++) {
+    const int first = b * COMPRESSED_BLOCK_SIZE;
+    const int last = (first + COMPRESSED_BLOCK_SIZE <= N)
+                         ? first + COMPRESSED_BLOCK_SIZE - 1
+                         : N;
+    struct compressed_block *blk = &sc->blocks[b];
+
+    /* The cdf at the left endpoints, with F = 1 for the final entry */
+    double F_first = (first < N) ? s->intervals[first].Fl : 1.0;
+    double F_last = (last < N) ? s->intervals[last].Fl : 1.0;
+    blk->F0 = F_first;
+    blk->F_scale = (F_last - F_first) / UINT32_MAX;
+
+    /* Determine the range of the coefficients in this block */
+    double x0 = (first < N) ? s->intervals[first].a0 : 0.;
+    double max_a0 = 0., max_a1 = 0., max_a2 = 0., max_a3 = 0.;
+    for (int i = first; i <= last && i < N; i++) {
+      struct interval *iv = &s->intervals[i];
+      max_a0 = fmax(max_a0, fabs(iv->a0 - x0));
+      max_a1 = fmax(max_a1, fabs(iv->a1));
+      max_a2 = fmax(max_a2, fabs(iv->a2));
+      max_a3 = fmax(max_a3, fabs(iv->a3));
+    }
+    blk->x0 = x0;
+    blk->x_scale = choose_scale(max_a0, UINT32_MAX);
+    blk->a1_scale = choose_scale(max_a1, INT32_MAX);
+    blk->a2_scale = choose_scale(max_a2, INT32_MAX);
+    blk->a3_scale = choose_scale(max_a3, INT32_MAX);
+
+    /* Encode the intervals */
+    for (int i = first; i <= last; i++) {
+      struct compressed_interval *ci = &sc->intervals[i];
+      double F = (i < N) ? s->intervals[i].Fl : 1.0;
+      ci->F = quantize(F - F_first, blk->F_scale, UINT32_MAX);
+
+      if (i < N) {
+        struct interval *iv = &s->intervals[i];
+        ci->a0 = quantize(iv->a0 - x0, blk->x_scale, UINT32_MAX);
+        ci->a1 = quantize(iv->a1, blk->a1_scale, INT32_MAX);
+        ci->a2 = quantize(iv->a2, blk->a2_scale, INT32_MAX);
+        ci->a3 = quantize(iv->a3, blk->a3_scale, INT32_MAX);
+      } else {
+        ci->a0 = ci->a1 = ci->a2 = ci->a3 = 0;
+      }
+    }
+  }
+
+  for (int i = 0; i < SEARCH_TABLE_LENGTH; i++) {
+    sc->index[i] = (int)s->index[i];
+  }
+
+  /* Check the error of the decoded interpolation inside each interval */
+  double max_error = 0.;
+  for (int i = 0; i < N; i++) {
+    double Fl = compressed_cdf(sc, i);
+    double Fr = compressed_cdf(sc, i + 1);
+
+    /* Intervals that collapse in fixed point are never selected */
+    if (!(Fr > Fl)) continue;
+
+    for (int j = 1; j < 4; j++) {
+      double u = Fl + 0.25 * j * (Fr - Fl);
+      double x = draw_sampler_compressed(sc, u);
+
+      /* A draw that decodes to NaN fails the check */
+      double error = isnan(x) ? INFINITY : fabs(sampler_cdf(s, x) - u);
+      if (error > max_error) max_error = error;
+    }
+  }
+
+  return (max_error > tol) ? max_error : 0.;
+}
+
+/**
+ * @brief Initialize a numerical inversion sampler with compressed tables.
+ *
+ * @param sc The #sampler_compressed to initialize
+ * @param f Function reference of the probability density function
+ * @param xl Left endpoint of the domain
+ * @param xr Right endpoint of the domain
+ * @param tol Tolerance for the Hermite interpolation, including compression
+ * @param params Parameters to be passed to the pdf
+ *
+ * Half of the tolerance is used for the double-precision tables and the other
+ * half is left for the compression. Smaller intervals span a smaller range
+ * of x in each block, so the tables are refined until the compressed tables
+ * pass the check. Returns 0 on success and 1 if the tolerance cannot be met,
+ * by the double-precision tables or after compression, in which case the
+ * tables are still usable but less accurate than requested.
+ * The 32-bit offsets support tolerances down to about 1e-11.
+ */
+int init_sampler_compressed(struct sampler_compressed *sc, pdf f, double xl,
+                            double xr, double tol, void *params) {
+  /* Give up when the tables get much finer than needed in double precision */
+  const int max_refinements = 3;
+  double build_tol = 0.5 * tol;
+
+  /* The compression is checked against the double-precision tables, so
+   * these must meet their tolerance as well */
+  struct sampler s;
+  int err = init_sampler(&s, f, NULL, xl, xr, build_tol, params);
+
+  for (int refinement = 0; ; refinement++) {
+    double error = compress_sampler(sc, &s, 0.5 * tol);
+
+    if (error == 0. || refinement == max_refinements) {
+      clean_sampler(&s);
+      return (err || error != 0.) ? 1 : 0;
+    }
+
+    /* Try again with finer tables */
+    clean_sampler_compressed(sc);
+    build_tol *= 0.25;
+    err = refine_sampler(&s, build_tol);
+  }
+}
+
+/**
+ * @brief Clean up the compressed sampler
+ *
+ * @param sc The #sampler_compressed to be cleaned
+ */
+void clean_sampler_compressed(struct sampler_compressed *sc) {
+  free(sc->intervals);
+  free(sc->blocks);
+  free(sc->index);
+}
+
+/* Find the same interval as draw_sampler_compressed, i.e. the first interval
+ * with F(r) >= u, by branch-free bisection between the search table entries
+ * of u and of the next value in the table */
+static inline int bisect_interval(const struct sampler_compressed *sc,
+                                  double u) {
+  const int tablength = SEARCH_TABLE_LENGTH;
+  const int last = sc->intervalNum - 1;
+  int int_u = (int)(u * tablength);
+  int k = int_u < tablength ? int_u : tablength - 1;
+  int lo = sc->index[k];
+  int hi = (k + 1 < tablength) ? sc->index[k + 1] + 1 : last;
+  if (hi > last) hi = last;
+
+  int len = hi - lo + 1;
+  while (len > 1) {
+    int half = len / 2;
+    lo = (compressed_cdf(sc, lo + half) < u) ? lo + half : lo;
+    len -= half;
+  }
+
+  /* Guard against rounding of u at the edges of the table cells */
+  while (lo < last && compressed_cdf(sc, lo + 1) < u) lo++;
+  return lo;
+}
+
+/**
+ * @brief Transform an array of uniform random numbers into custom variates
+ *
+ * @param sc The #sampler_compressed for the distribution
+ * @param u Array of random numbers to be transformed
+ * @param x Output array of custom variates
+ * @param n Number of random numbers
+ *
+ * The interval of each element is located PREFETCH_DISTANCE elements ahead
+ * and prefetched together with its block, as in draw_sampler_batch.
+ */
+void draw_sampler_compressed_batch(const struct sampler_compressed *sc,
+                                   const double *u, double *x, int n) {
+  const int D = PREFETCH_DISTANCE;
+
+  /* The intervals found for the next D elements, indexed modulo D */
+  int found[PREFETCH_DISTANCE];
+
+  for (int i = -D; i < n; i++) {
+    if (i >= 0) {
+      int j = found[i % D];
+      const struct compressed_block *blk =
+          &sc->blocks[j / COMPRESSED_BLOCK_SIZE];
+      const struct compressed_interval *iv = &sc->intervals[j];
+      double Fl = blk->F0 + blk->F_scale * iv->F;
+      double Fr = compressed_cdf(sc, j + 1);
+
+      /* Decode the interval */
+      double a0 = blk->x0 + blk->x_scale * iv->a0;
+      double a1 = blk->a1_scale * iv->a1;
+      double a2 = blk->a2_scale * iv->a2;
+      double a3 = blk->a3_scale * iv->a3;
+
+      double u_tilde = (u[i] - Fl) / (Fr - Fl);
+      x[i] = hermite_cubic(a0, a1, a2, a3, u_tilde);
+    }
+
+    if (i + D < n) {
+      int j = bisect_interval(sc, u[i + D]);
+      __builtin_prefetch(&sc->intervals[j]);
+      __builtin_prefetch(&sc->blocks[j / COMPRESSED_BLOCK_SIZE]);
+      found[(i + D) % D] = j;
+    }
+  }
+}
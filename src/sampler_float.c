@@ -0,0 +1,201 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+
+#include "../include/sampler_float.h"
+
+/* Number of variates that are searched in lockstep by the batch draw */
+#define FLOAT_BATCH_BLOCK 64
+
+/**
+ * @brief Convert the tables of a double-precision #sampler to single precision
+ * and check the interpolation error of the float tables.
+ *
+ * @param sf The #sampler_float to fill
+ * @param s The initialized #sampler to copy the tables from
+ * @param tol Tolerance that the float tables have to satisfy
+ *
+ * Returns the maximum error if it exceeds tol and 0 otherwise, or -1 if the
+ * tables cannot be allocated, in which case all table pointers are NULL.
+ */
+static double convert_tables(struct sampler_float *sf, struct sampler *s,
+                             double tol) {
+  sf->intervalNum = s->intervalNum;
+  sf->endpoints = malloc((sf->intervalNum + 1) * sizeof(float));
+  sf->splines = malloc(4 * (size_t)sf->intervalNum * sizeof(float));
+  sf->index = malloc(SEARCH_TABLE_LENGTH * sizeof(int));
+
+  if (sf->endpoints == NULL || sf->splines == NULL || sf->index == NULL) {
+    clean_sampler_float(sf);
+    sf->endpoints = NULL;
+    sf->splines = NULL;
+    sf->index = NULL;
+    return -1.;
+  }
+
+  /* Convert the tables to single precision */
+  for (int i = 0; i < sf->intervalNum; i++) {
+    struct interval *iv = &s->intervals[i];
+    sf->endpoints[i] = iv->Fl;
+    sf->splines[4 * i + 0] = iv->a0;
+    sf->splines[4 * i + 1] = iv->a1;
+    sf->splines[4 * i + 2] = iv->a2;
+    sf->splines[4 * i + 3] = iv->a3;
+  }
+  sf->endpoints[sf->intervalNum] = 1.0f;
+
+  for (int i = 0; i < SEARCH_TABLE_LENGTH; i++) {
+    sf->index[i] = (int)s->index[i];
+  }
+
+  /* Check the error of the float interpolation inside each interval */
+  double max_error = 0.;
+  for (int i = 0; i < sf->intervalNum; i++) {
+    float Fl = sf->endpoints[i];
+    float Fr = sf->endpoints[i + 1];
+
+    /* Intervals that collapse in single precision are never selected */
+    if (!(Fr > Fl)) continue;
+
+    for (int j = 1; j < 4; j++) {
+      float u = Fl + 0.25f * j * (Fr - Fl);
+      float x = draw_sampler_float(sf, u);
+      double F = s->norm * numerical_cdf(s->xl, x, s->f, s->params);
+      if (fabs(F - u) > max_error) max_error = fabs(F - u);
+    }
+  }
+
+  return (max_error > tol) ? max_error : 0.;
+}
+
+/**
+ * @brief Initialize a single-precision numerical inversion sampler.
+ *
+ * @param sf The #sampler_float to initialize
+ * @param f Function reference of the probability density function
+ * @param xl Left endpoint of the domain
+ * @param xr Right endpoint of the domain
+ * @param tol Tolerance for the Hermite interpolation in single precision
+ * @param params Parameters to be passed to the pdf
+ *
+ * The double-precision tables are built with a tighter tolerance, leaving
+ * room for the rounding errors of float tables and float arithmetic. The
+ * tolerance is tightened further until the float tables pass the same error
+ * check as init_sampler. Returns 0 on success and 1 if the tolerance cannot be
+ * met in single precision or by the double-precision tables, in which case the
+ * tables are still usable but less accurate than requested. Also returns 1 if
+ * the float tables cannot be allocated, in which case they are NULL.
+ */
+int init_sampler_float(struct sampler_float *sf, pdf f, double xl, double xr,
+                       double tol, void *params) {
+  /* The tolerance cannot be smaller than the resolution of a float */
+  const double min_tol = 4 * FLT_EPSILON;
+  double build_tol = 0.5 * tol;
+
+  while (1) {
+    struct sampler s;
+    int err = init_sampler(&s, f, NULL, xl, xr, build_tol, params);
+    double error = convert_tables(sf, &s, tol);
+    clean_sampler(&s);
+
+    if (error < 0.) {
+      return 1;
+    } else if (error == 0.) {
+      return err ? 1 : 0;
+    } else if (err || tol < min_tol || build_tol < min_tol) {
+      /* A tighter tolerance cannot be met if this one was not */
+      return 1;
+    }
+
+    /* Try again with a tighter tolerance */
+    clean_sampler_float(sf);
+    build_tol *= 0.25;
+  }
+}
+
+/**
+ * @brief Clean up the single-precision sampler
+ *
+ * @param sf The #sampler_float to be cleaned
+ */
+void clean_sampler_float(struct sampler_float *sf) {
+  free(sf->endpoints);
+  free(sf->splines);
+  free(sf->index);
+}
+
+/**
+ * @brief Transform an array of uniform random numbers into custom variates
+ *
+ * @param sf The #sampler_float for the distribution
+ * @param u Array of random numbers to be transformed
+ * @param x Output array of custom variates
+ * @param n Number of random numbers
+ *
+ * Blocks of FLOAT_BATCH_BLOCK variates are searched in lockstep, as in the
+ * batch kernel of the generated headers: the search table and two
+ * branch-free steps of the linear search are vectorized, the few longer
+ * searches are finished one by one and the splines are again evaluated in
+ * vectors. The results are the same as those of draw_sampler_float.
+ */
+void draw_sampler_float_batch(const struct sampler_float *sf, const float *u,
+                              float *x, int n) {
+  const int tablength = SEARCH_TABLE_LENGTH;
+  const int last = sf->intervalNum - 1;
+  const float *ends = sf->endpoints;
+  const float *splines = sf->splines;
+  const int *guide = sf->index;
+  int idx[FLOAT_BATCH_BLOCK];
+
+  for (int k = 0; k < n; k += FLOAT_BATCH_BLOCK) {
+    const int m = (n - k < FLOAT_BATCH_BLOCK) ? n - k : FLOAT_BATCH_BLOCK;
+    const float *uk = u + k;
+
+    /* Use the search table to find a nearby interval in every lane */
+    for (int j = 0; j < m; j++) {
+      int int_u = (int)(uk[j] * tablength);
+      idx[j] = guide[int_u < tablength ? int_u : tablength - 1];
+    }
+
+    /* Advance all lanes in lockstep by the typical length of the search,
+     * without branches such that the loop is vectorized */
+    for (int step = 0; step < 2; step++) {
+      for (int j = 0; j < m; j++) {
+        idx[j] += (idx[j] < last) & (ends[idx[j] + 1] < uk[j]);
+      }
+    }
+
+    /* Finish the few lanes with longer searches one by one */
+    for (int j = 0; j < m; j++) {
+      while (idx[j] < last && ends[idx[j] + 1] < uk[j]) idx[j]++;
+    }
+
+    /* Evaluate the Hermite approximations in every lane */
+    for (int j = 0; j < m; j++) {
+      const float *a = &splines[4 * idx[j]];
+      float Fl = ends[idx[j]];
+      float Fr = ends[idx[j] + 1];
+      float u_tilde = (uk[j] - Fl) / (Fr - Fl);
+      x[k + j] = hermite_cubicf(a[0], a[1], a[2], a[3], u_tilde);
+    }
+  }
+}
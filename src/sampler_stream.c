@@ -0,0 +1,217 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include <stdlib.h>
+
+#include "../include/sampler_stream.h"
+
+/* Block until the ring buffer is no longer full (for the producer) or no
+ * longer empty (for the consumer), or until the stream is stopped. The flag
+ * of the waiting thread is raised before the condition is checked again, and
+ * the other thread checks it after updating its counter, so a wake-up cannot
+ * be lost. */
+static void stream_wait(struct stream_ring *ring, int producer) {
+  struct sampler_stream *st = ring->stream;
+
+  pthread_mutex_lock(&ring->lock);
+  atomic_store(&ring->waiting[producer], 1);
+  while (!atomic_load(&st->stop)) {
+    size_t head = atomic_load(&ring->head);
+    size_t tail = atomic_load(&ring->tail);
+    if (producer ? head - tail < (size_t)st->chunkNum : head != tail) break;
+    pthread_cond_wait(&ring->cond[producer], &ring->lock);
+  }
+  atomic_store(&ring->waiting[producer], 0);
+  pthread_mutex_unlock(&ring->lock);
+}
+
+/* Wake up the producer (1) or the consumer (0) of a ring buffer if it is
+ * waiting */
+static void stream_wake(struct stream_ring *ring, int producer) {
+  if (atomic_load(&ring->waiting[producer])) {
+    pthread_mutex_lock(&ring->lock);
+    pthread_cond_signal(&ring->cond[producer]);
+    pthread_mutex_unlock(&ring->lock);
+  }
+}
+
+/* Stop the producer threads of the first ringNum rings and wait for them */
+static void stream_join(struct sampler_stream *st, int ringNum) {
+  atomic_store(&st->stop, 1);
+  for (int i = 0; i < ringNum; i++) {
+    pthread_mutex_lock(&st->rings[i].lock);
+    pthread_cond_broadcast(&st->rings[i].cond[0]);
+    pthread_cond_broadcast(&st->rings[i].cond[1]);
+    pthread_mutex_unlock(&st->rings[i].lock);
+    pthread_join(st->rings[i].thread, NULL);
+  }
+}
+
+/* Free the ring buffers of the first ringNum rings */
+static void stream_free(struct sampler_stream *st, int ringNum) {
+  for (int i = 0; i < ringNum; i++) {
+    pthread_mutex_destroy(&st->rings[i].lock);
+    pthread_cond_destroy(&st->rings[i].cond[0]);
+    pthread_cond_destroy(&st->rings[i].cond[1]);
+    free(st->rings[i].data);
+  }
+  free(st->rings);
+}
+
+/* The producer thread: keep the ring buffer filled until told to stop */
+static void *stream_producer(void *arg) {
+  struct stream_ring *ring = (struct stream_ring *)arg;
+  struct sampler_stream *st = ring->stream;
+  const int len = st->chunkLength;
+
+  while (!atomic_load_explicit(&st->stop, memory_order_relaxed)) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    /* Wait for the consumer to release a chunk if the buffer is full */
+    if (head - tail >= (size_t)st->chunkNum) {
+      stream_wait(ring, 1);
+      continue;
+    }
+
+    /* Fill the next chunk, transforming the uniforms in place */
+    double *chunk = ring->data + (head % st->chunkNum) * len;
+    for (int i = 0; i < len; i++) {
+      chunk[i] = sampleUniform(&ring->state);
+    }
+    draw_sampler_batch(st->s, chunk, chunk, len);
+
+    /* Publish the chunk */
+    atomic_store(&ring->head, head + 1);
+    stream_wake(ring, 0);
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief Start background threads that produce variates from a sampler
+ *
+ * @param st The #sampler_stream to start
+ * @param s The #sampler to draw from, which must outlive the stream
+ * @param consumers Number of consumer threads, each served by one producer
+ * @param chunkLength Number of variates per chunk
+ * @param chunkNum Number of chunks in each ring buffer
+ * @param seed Seed for the random number generators
+ *
+ * Each producer uses its own random number generator, obtained from the seed
+ * by jumping ahead, so that the streams do not overlap. Producers with a full
+ * buffer and consumers with an empty buffer sleep until they are woken up.
+ * Returns 0 on success and 1 if the memory or threads could not be
+ * allocated.
+ */
+int sampler_stream_start(struct sampler_stream *st, struct sampler *s,
+                         int consumers, int chunkLength, int chunkNum,
+                         uint64_t seed) {
+  st->s = s;
+  st->ringNum = consumers;
+  st->chunkNum = chunkNum;
+  st->chunkLength = chunkLength;
+  atomic_init(&st->stop, 0);
+  st->rings = aligned_alloc(64, consumers * sizeof(struct stream_ring));
+  if (st->rings == NULL) return 1;
+
+  rng_state state = rand_uint64_init(seed);
+  for (int i = 0; i < consumers; i++) {
+    struct stream_ring *ring = &st->rings[i];
+    ring->data = malloc((size_t)chunkNum * chunkLength * sizeof(double));
+    if (ring->data == NULL) {
+      stream_free(st, i);
+      return 1;
+    }
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->waiting[0], 0);
+    atomic_init(&ring->waiting[1], 0);
+    pthread_mutex_init(&ring->lock, NULL);
+    pthread_cond_init(&ring->cond[0], NULL);
+    pthread_cond_init(&ring->cond[1], NULL);
+    ring->offset = 0;
+    ring->state = state;
+    ring->stream = st;
+    rand_uint64_jump(&state);
+  }
+
+  for (int i = 0; i < consumers; i++) {
+    if (pthread_create(&st->rings[i].thread, NULL, stream_producer,
+                       &st->rings[i]) != 0) {
+      /* Stop the threads that were started */
+      stream_join(st, i);
+      stream_free(st, consumers);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Obtain the next variates for a consumer thread, without copying
+ *
+ * @param st The #sampler_stream
+ * @param consumer Index of the consumer, each used by a single thread only
+ * @param n Maximum number of variates requested
+ * @param got Output, the number of variates returned, at least one
+ *
+ * Returns a pointer to the variates inside the ring buffer, which stays valid
+ * until the next call by the same consumer. Fewer than n variates are
+ * returned at the end of a chunk. Waits only if the producer is behind.
+ */
+const double *sampler_stream_next(struct sampler_stream *st, int consumer,
+                                  int n, int *got) {
+  struct stream_ring *ring = &st->rings[consumer];
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+  /* Release the chunk if it was handed out completely */
+  if (ring->offset == st->chunkLength) {
+    tail++;
+    ring->offset = 0;
+    atomic_store(&ring->tail, tail);
+    stream_wake(ring, 1);
+  }
+
+  /* Wait for the producer if no chunk is available */
+  if (atomic_load_explicit(&ring->head, memory_order_acquire) == tail) {
+    stream_wait(ring, 0);
+  }
+
+  /* Hand out a span of the current chunk */
+  int left = st->chunkLength - ring->offset;
+  *got = (n < left) ? n : left;
+  const double *span =
+      ring->data + (tail % st->chunkNum) * st->chunkLength + ring->offset;
+  ring->offset += *got;
+
+  return span;
+}
+
+/**
+ * @brief Stop the producer threads and free the ring buffers
+ *
+ * @param st The #sampler_stream to stop
+ */
+void sampler_stream_stop(struct sampler_stream *st) {
+  stream_join(st, st->ringNum);
+  stream_free(st, st->ringNum);
+}
@@ -0,0 +1,367 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../include/tabulated.h"
+
+/* Relative distance by which a domain endpoint with zero density is moved
+ * into the first or last grid cell */
+#define TABULATED_EDGE_OFFSET 1e-6
+
+/* Find the grid cell k such that x[k] <= x < x[k+1] and the relative
+ * position t in the cell */
+static inline int tabulated_locate(const struct tabulated_pdf *t, double x,
+                                   double *h, double *u) {
+  int lo = 0;
+  int hi = t->n - 1;
+  while (hi - lo > 1) {
+    int mid = (lo + hi) / 2;
+    if (t->x[mid] <= x) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+
+  *h = t->x[lo + 1] - t->x[lo];
+  *u = (x - t->x[lo]) / *h;
+  return lo;
+}
+
+/* Integral of the cubic Hermite spline over the first fraction u of a cell */
+static inline double cell_integral(const struct tabulated_pdf *t, int k,
+                                   double h, double u) {
+  double u2 = u * u;
+  double u3 = u2 * u;
+  double u4 = u3 * u;
+  return h * (t->f[k] * (0.5 * u4 - u3 + u) +
+              h * t->m[k] * (0.25 * u4 - 2. / 3. * u3 + 0.5 * u2) +
+              t->f[k + 1] * (-0.5 * u4 + u3) +
+              h * t->m[k + 1] * (0.25 * u4 - 1. / 3. * u3));
+}
+
+/**
+ * @brief Fit a monotone cubic spline to a tabulated pdf
+ *
+ * @param t The #tabulated_pdf to initialize
+ * @param x Array of n grid points, in increasing order
+ * @param f Array of n pdf values, which may be zero only at the ends
+ * @param n Number of grid points, at least 2
+ *
+ * The slopes are chosen with the Fritsch-Carlson method, such that the
+ * spline is monotone between the grid points and therefore never negative.
+ * The spline is integrated exactly, so no numerical integration is needed
+ * when building a sampler. Returns 0 on success and 1 if the input is
+ * invalid or if the memory could not be allocated.
+ */
+int init_tabulated_pdf(struct tabulated_pdf *t, const double *x,
+                       const double *f, int n) {
+  if (n < 2) return 1;
+  for (int k = 0; k < n; k++) {
+    if (k > 0 && !(x[k] > x[k - 1])) return 1;
+    if (!(f[k] >= 0.) || (f[k] == 0. && k > 0 && k < n - 1)) return 1;
+  }
+
+  t->n = n;
+  t->x = malloc(n * sizeof(double));
+  t->f = malloc(n * sizeof(double));
+  t->m = malloc(n * sizeof(double));
+  t->F = malloc(n * sizeof(double));
+  double *d = malloc((n - 1) * sizeof(double));
+  if (t->x == NULL || t->f == NULL || t->m == NULL || t->F == NULL ||
+      d == NULL) {
+    clean_tabulated_pdf(t);
+    free(d);
+    return 1;
+  }
+  memcpy(t->x, x, n * sizeof(double));
+  memcpy(t->f, f, n * sizeof(double));
+
+  /* Slopes of the secants */
+  for (int k = 0; k < n - 1; k++) {
+    d[k] = (f[k + 1] - f[k]) / (x[k + 1] - x[k]);
+  }
+
+  /* Weighted harmonic mean of the secants at interior points, or zero at
+   * local extrema */
+  for (int k = 1; k < n - 1; k++) {
+    if (d[k - 1] * d[k] <= 0.) {
+      t->m[k] = 0.;
+    } else {
+      double h0 = x[k] - x[k - 1];
+      double h1 = x[k + 1] - x[k];
+      double w0 = 2. * h1 + h0;
+      double w1 = h1 + 2. * h0;
+      t->m[k] = (w0 + w1) / (w0 / d[k - 1] + w1 / d[k]);
+    }
+  }
+
+  /* One-sided three-point estimates at the ends */
+  if (n == 2) {
+    t->m[0] = t->m[1] = d[0];
+  } else {
+    for (int end = 0; end < 2; end++) {
+      int k = end ? n - 1 : 0;
+      double h0 = end ? x[n - 1] - x[n - 2] : x[1] - x[0];
+      double h1 = end ? x[n - 2] - x[n - 3] : x[2] - x[1];
+      double d0 = end ? d[n - 2] : d[0];
+      double d1 = end ? d[n - 3] : d[1];
+      double m = ((2. * h0 + h1) * d0 - h0 * d1) / (h0 + h1);
+      if (m * d0 <= 0.) {
+        m = 0.;
+      } else if (d0 * d1 <= 0. && fabs(m) > 3. * fabs(d0)) {
+        m = 3. * d0;
+      }
+      t->m[k] = m;
+    }
+  }
+  free(d);
+
+  /* Cumulative integrals at the grid points */
+  t->F[0] = 0.;
+  for (int k = 0; k < n - 1; k++) {
+    t->F[k + 1] = t->F[k] + cell_integral(t, k, x[k + 1] - x[k], 1.0);
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Free the memory of a tabulated pdf
+ *
+ * @param t The #tabulated_pdf to clean
+ */
+void clean_tabulated_pdf(struct tabulated_pdf *t) {
+  free(t->x);
+  free(t->f);
+  free(t->m);
+  free(t->F);
+}
+
+/**
+ * @brief Evaluate the interpolated pdf, for use as a #pdf with the
+ * #tabulated_pdf as parameters
+ *
+ * @param x The point at which to evaluate the pdf
+ * @param params Pointer to the #tabulated_pdf
+ */
+double tabulated_pdf_eval(double x, void *params) {
+  const struct tabulated_pdf *t = (const struct tabulated_pdf *)params;
+  if (x < t->x[0] || x > t->x[t->n - 1]) return 0.;
+
+  double h, u;
+  int k = tabulated_locate(t, x, &h, &u);
+  double u2 = u * u;
+  double u3 = u2 * u;
+  return t->f[k] * (2. * u3 - 3. * u2 + 1.) +
+         h * t->m[k] * (u3 - 2. * u2 + u) +
+         t->f[k + 1] * (-2. * u3 + 3. * u2) +
+         h * t->m[k + 1] * (u3 - u2);
+}
+
+/**
+ * @brief Evaluate the derivative of the interpolated pdf
+ *
+ * @param x The point at which to evaluate the derivative
+ * @param params Pointer to the #tabulated_pdf
+ */
+double tabulated_pdf_deriv(double x, void *params) {
+  const struct tabulated_pdf *t = (const struct tabulated_pdf *)params;
+  if (x < t->x[0] || x > t->x[t->n - 1]) return 0.;
+
+  double h, u;
+  int k = tabulated_locate(t, x, &h, &u);
+  double u2 = u * u;
+  return (t->f[k] * (6. * u2 - 6. * u) + t->f[k + 1] * (6. * u - 6. * u2)) / h +
+         t->m[k] * (3. * u2 - 4. * u + 1.) + t->m[k + 1] * (3. * u2 - 2. * u);
+}
+
+/**
+ * @brief Evaluate the exact integral of the interpolated pdf from the first
+ * grid point, for use as the cdf of a #sampler
+ *
+ * @param x The upper limit of the integral
+ * @param params Pointer to the #tabulated_pdf
+ */
+double tabulated_pdf_cdf(double x, void *params) {
+  const struct tabulated_pdf *t = (const struct tabulated_pdf *)params;
+  if (x <= t->x[0]) return 0.;
+  if (x >= t->x[t->n - 1]) return t->F[t->n - 1];
+
+  double h, u;
+  int k = tabulated_locate(t, x, &h, &u);
+  return t->F[k] + cell_integral(t, k, h, u);
+}
+
+/**
+ * @brief Initialize a sampler for a tabulated pdf
+ *
+ * @param s The #sampler to initialize
+ * @param t The initialized #tabulated_pdf, which must outlive the sampler
+ * @param tol Tolerance for the Hermite interpolation
+ *
+ * The domain is the range of the grid. Endpoints with zero density are moved
+ * slightly inwards, since the inversion requires a positive density at the
+ * endpoints. Returns 0 on success and 1 if the tolerance could not be met
+ * everywhere.
+ */
+int init_sampler_tabulated(struct sampler *s, struct tabulated_pdf *t,
+                           double tol) {
+  int n = t->n;
+  double xl = t->x[0];
+  double xr = t->x[n - 1];
+  if (t->f[0] == 0.) {
+    xl += TABULATED_EDGE_OFFSET * (t->x[1] - t->x[0]);
+  }
+  if (t->f[n - 1] == 0.) {
+    xr -= TABULATED_EDGE_OFFSET * (t->x[n - 1] - t->x[n - 2]);
+  }
+
+  return init_sampler_cdf(s, tabulated_pdf_eval, tabulated_pdf_cdf,
+                          tabulated_pdf_deriv, xl, xr, tol, t);
+}
+
+/* Compare point masses by location */
+static int compare_atoms(const void *a, const void *b) {
+  const double *da = (const double *)a;
+  const double *db = (const double *)b;
+  return (da[0] > db[0]) - (da[0] < db[0]);
+}
+
+/**
+ * @brief Initialize a sampler for a mixture of a continuous distribution and
+ * a number of point masses
+ *
+ * @param ms The #mixed_sampler to initialize
+ * @param continuous Initialized #sampler for the continuous part, or NULL
+ * @param weight Relative weight of the continuous part
+ * @param atoms Array of locations of the point masses
+ * @param probs Array of relative weights of the point masses
+ * @param atomNum Number of point masses
+ *
+ * The weights are normalized to unit total probability. The continuous
+ * sampler is not copied and must outlive the mixed sampler.
+ */
+void init_mixed_sampler(struct mixed_sampler *ms, struct sampler *continuous,
+                        double weight, const double *atoms,
+                        const double *probs, int atomNum) {
+  ms->continuous = continuous;
+  ms->atomNum = atomNum;
+  ms->atoms = malloc(atomNum * sizeof(double));
+  ms->probs = malloc(atomNum * sizeof(double));
+  ms->G_lo = malloc(atomNum * sizeof(double));
+  ms->P = malloc(atomNum * sizeof(double));
+
+  /* Sort the point masses by location */
+  double *pairs = malloc(2 * atomNum * sizeof(double));
+  for (int j = 0; j < atomNum; j++) {
+    pairs[2 * j] = atoms[j];
+    pairs[2 * j + 1] = probs[j];
+  }
+  qsort(pairs, atomNum, 2 * sizeof(double), compare_atoms);
+
+  /* Normalize the weights */
+  double total = (continuous != NULL) ? weight : 0.;
+  for (int j = 0; j < atomNum; j++) {
+    total += pairs[2 * j + 1];
+  }
+  ms->weight = (continuous != NULL) ? weight / total : 0.;
+
+  /* Thresholds of the total cdf at the point masses */
+  double P = 0.;
+  for (int j = 0; j < atomNum; j++) {
+    double x = pairs[2 * j];
+    double Fc = (continuous != NULL) ? sampler_cdf(continuous, x) : 0.;
+    ms->atoms[j] = x;
+    ms->probs[j] = pairs[2 * j + 1] / total;
+    ms->G_lo[j] = P + ms->weight * Fc;
+    P += ms->probs[j];
+    ms->P[j] = P;
+  }
+  free(pairs);
+}
+
+/**
+ * @brief Free the memory of a mixed sampler, except the continuous sampler
+ *
+ * @param ms The #mixed_sampler to clean
+ */
+void clean_mixed_sampler(struct mixed_sampler *ms) {
+  free(ms->atoms);
+  free(ms->probs);
+  free(ms->G_lo);
+  free(ms->P);
+}
+
+/**
+ * @brief Transform a uniform random number into a variate from the mixed
+ * distribution, by inverting the total cdf
+ *
+ * @param ms The #mixed_sampler for the distribution
+ * @param u Random number to be transformed
+ */
+double draw_mixed_sampler(struct mixed_sampler *ms, double u) {
+  /* Find the last point mass with G_lo <= u */
+  int lo = -1;
+  int hi = ms->atomNum;
+  while (hi - lo > 1) {
+    int mid = (lo + hi) / 2;
+    if (ms->G_lo[mid] <= u) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+
+  /* Without a continuous part, the random number falls on a point mass */
+  if (ms->weight == 0.) {
+    return ms->atoms[lo >= 0 ? lo : 0];
+  }
+
+  /* The random number falls on the point mass */
+  if (lo >= 0 && u < ms->G_lo[lo] + ms->probs[lo]) {
+    return ms->atoms[lo];
+  }
+
+  /* Otherwise, invert the continuous part with the atoms below removed */
+  double P = (lo >= 0) ? ms->P[lo] : 0.;
+  double v = (u - P) / ms->weight;
+  v = (v < 0.) ? 0. : (v > 1.) ? 1. : v;
+  return draw_sampler(ms->continuous, v);
+}
+
+/**
+ * @brief Transform an array of uniform random numbers into variates from the
+ * mixed distribution
+ *
+ * @param ms The #mixed_sampler for the distribution
+ * @param u Array of random numbers to be transformed
+ * @param x Output array of variates
+ * @param n Number of random numbers
+ */
+void draw_mixed_sampler_batch(struct mixed_sampler *ms, const double *u,
+                              double *x, int n) {
+  for (int i = 0; i < n; i++) {
+    x[i] = draw_mixed_sampler(ms, u[i]);
+  }
+}
@@ -0,0 +1,275 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "../include/tail_sampler.h"
+
+/* Number of bisection steps used to locate points in the tails */
+#define TAIL_BISECTION_STEPS 64
+
+/* Width of the first integration block, its growth factor and the maximum
+ * width, relative to the length of the integration range */
+#define TAIL_FIRST_BLOCK 1e-6
+#define TAIL_BLOCK_GROWTH 1.5
+#define TAIL_MAX_BLOCK (1. / 32.)
+
+/* Nodes and weights of the 16-point Gauss-Legendre rule on [-1, 1] */
+static const double gauss_legendre[8][2] = {
+    {0.98940093499164993, 0.027152459411754095},
+    {0.94457502307323258, 0.062253523938647893},
+    {0.86563120238783174, 0.095158511682492785},
+    {0.75540440835500303, 0.12462897125553387},
+    {0.61787624440264375, 0.14959598881657673},
+    {0.45801677765722739, 0.16915651939500254},
+    {0.28160355077925891, 0.18260341504492359},
+    {0.09501250983763744, 0.1894506104550685}};
+
+/* Integrate the pdf between x and x_end, in blocks whose width grows
+ * geometrically away from x, where the mass of a tail is concentrated. The
+ * midpoint rule of numerical_cdf() is not accurate enough for the relative
+ * precision that is needed deep in the tails. */
+static double tail_integral(pdf f, void *params, double x, double x_end) {
+  const double L = fabs(x_end - x);
+  const double dir = (x_end > x) ? 1. : -1.;
+  double width = TAIL_FIRST_BLOCK * L;
+  double pos = 0.;
+  double out = 0.;
+
+  while (pos < L) {
+    double w = fmin(width, L - pos);
+    double c = x + dir * (pos + 0.5 * w);
+    double sum = 0.;
+    for (int k = 0; k < 8; k++) {
+      double dx = 0.5 * w * gauss_legendre[k][0];
+      sum += gauss_legendre[k][1] * (f(c - dx, params) + f(c + dx, params));
+    }
+    out += 0.5 * w * sum;
+
+    pos += w;
+    width = fmin(width * TAIL_BLOCK_GROWTH, TAIL_MAX_BLOCK * L);
+  }
+  return out;
+}
+
+/* Transformed cdf of the right tail, y = -log(Q(x) / p), with Q integrated
+ * directly over the tail instead of as 1 - F */
+static double right_tail_cdf(double x, void *params) {
+  struct tail_params *tp = (struct tail_params *)params;
+  return -log(tail_integral(tp->f, tp->params, x, tp->x_end) / tp->mass);
+}
+
+/* Derivative of the transformed cdf of the right tail, f(x) / Q(x) */
+static double right_tail_pdf(double x, void *params) {
+  struct tail_params *tp = (struct tail_params *)params;
+  return tp->f(x, tp->params) / tail_integral(tp->f, tp->params, x, tp->x_end);
+}
+
+/* Transformed cdf of the left tail, -y = log(F(x) / p), which increases
+ * with x as required for the tables */
+static double left_tail_cdf(double x, void *params) {
+  struct tail_params *tp = (struct tail_params *)params;
+  return log(tail_integral(tp->f, tp->params, tp->x_end, x) / tp->mass);
+}
+
+/* Derivative of the transformed cdf of the left tail, f(x) / F(x) */
+static double left_tail_pdf(double x, void *params) {
+  struct tail_params *tp = (struct tail_params *)params;
+  return tp->f(x, tp->params) / tail_integral(tp->f, tp->params, tp->x_end, x);
+}
+
+/* Find x in [a, b] such that g(x) = target for an increasing function g */
+static double tail_bisect(pdf g, void *params, double a, double b,
+                          double target) {
+  for (int i = 0; i < TAIL_BISECTION_STEPS; i++) {
+    double m = 0.5 * (a + b);
+    if (g(m, params) < target) {
+      a = m;
+    } else {
+      b = m;
+    }
+  }
+  return 0.5 * (a + b);
+}
+
+/* Fraction of the mass to the left of x, for the bisection */
+static double mass_below(double x, void *params) {
+  struct tail_params *tp = (struct tail_params *)params;
+  return tail_integral(tp->f, tp->params, tp->x_end, x) / tp->mass;
+}
+
+/**
+ * @brief Initialize a sampler with separate tables for the tails, in which
+ * the variates are parametrized by y = -log(Q(x) / p) on the right and
+ * y = -log(F(x) / p) on the left
+ *
+ * @param ts The #tail_sampler to initialize
+ * @param f Function reference of the probability density function
+ * @param xl Left endpoint of the domain
+ * @param xr Right endpoint of the domain
+ * @param p_left Probability of the left tail, or 0 for no left tail table
+ * @param p_right Probability of the right tail, or 0 for no right tail table
+ * @param tol Tolerance for the Hermite interpolation
+ * @param params Parameters to be passed to the pdf
+ *
+ * Within a tail, y has a standard exponential distribution, so deep tail
+ * variates can be generated with full relative precision from a fresh
+ * uniform random number. The tail tables extend to y = TAIL_DEPTH, beyond
+ * the reach of double-precision uniforms. They are accurate to tol / p in y,
+ * which corresponds to an error of tol in u at the start of a tail and to a
+ * relative error of tol / p in the tail probability beyond. The core table
+ * only covers the probability between the tails. The pdf must be positive
+ * in the tails up to the depth of the tables. Returns 0 on success and 1 if
+ * the core or a tail table could not meet its tolerance everywhere (see
+ * init_sampler), in which case the tables are still usable but less accurate.
+ */
+int init_tail_sampler(struct tail_sampler *ts, pdf f, double xl, double xr,
+                      double p_left, double p_right, double tol,
+                      void *params) {
+  /* Total mass of the pdf, for locating the tails */
+  struct tail_params total = {f, params, xl, 1.0};
+  total.mass = tail_integral(f, params, xl, xr);
+
+  /* Locate the boundaries of the tails and their exact probabilities */
+  double x_lo = xl;
+  double x_hi = xr;
+  ts->p_left = 0.;
+  ts->p_right = 0.;
+  if (p_left > 0.) {
+    x_lo = tail_bisect(mass_below, &total, xl, xr, p_left);
+    ts->p_left = mass_below(x_lo, &total);
+  }
+  if (p_right > 0.) {
+    x_hi = tail_bisect(mass_below, &total, x_lo, xr, 1. - p_right);
+    ts->p_right = tail_integral(f, params, x_hi, xr) / total.mass;
+  }
+
+  /* The core of the distribution */
+  int err = init_sampler(&ts->core, f, NULL, x_lo, x_hi, tol, params);
+
+  /* The left tail, down to F(x) = p * exp(-TAIL_DEPTH) */
+  if (ts->p_left > 0.) {
+    struct tail_params *tp = &ts->left_params;
+    tp->f = f;
+    tp->params = params;
+    tp->x_end = xl;
+    tp->mass = tail_integral(f, params, xl, x_lo);
+    double x_cut = tail_bisect(left_tail_cdf, tp, xl, x_lo, -TAIL_DEPTH);
+    double tol_y = tol / ts->p_left;
+    err |= init_sampler_cdf(&ts->left, left_tail_pdf, left_tail_cdf, NULL,
+                            x_cut, x_lo, tol_y / TAIL_DEPTH, tp);
+  }
+
+  /* The right tail, up to Q(x) = p * exp(-TAIL_DEPTH) */
+  if (ts->p_right > 0.) {
+    struct tail_params *tp = &ts->right_params;
+    tp->f = f;
+    tp->params = params;
+    tp->x_end = xr;
+    tp->mass = tail_integral(f, params, x_hi, xr);
+    double x_cut = tail_bisect(right_tail_cdf, tp, x_hi, xr, TAIL_DEPTH);
+    double tol_y = tol / ts->p_right;
+    err |= init_sampler_cdf(&ts->right, right_tail_pdf, right_tail_cdf, NULL,
+                            x_hi, x_cut, tol_y / TAIL_DEPTH, tp);
+  }
+
+  return err;
+}
+
+/**
+ * @brief Free the memory of the core and tail tables
+ *
+ * @param ts The #tail_sampler to clean
+ */
+void clean_tail_sampler(struct tail_sampler *ts) {
+  clean_sampler(&ts->core);
+  if (ts->p_left > 0.) clean_sampler(&ts->left);
+  if (ts->p_right > 0.) clean_sampler(&ts->right);
+}
+
+/* Variate in the left tail for a given y = -log(F(x) / p_left) */
+static inline double draw_left_tail(struct tail_sampler *ts, double y) {
+  double u = 1. - y * ts->left.norm;
+  return draw_sampler(&ts->left, u > 0. ? u : 0.);
+}
+
+/* Variate in the right tail for a given y = -log(Q(x) / p_right) */
+static inline double draw_right_tail(struct tail_sampler *ts, double y) {
+  double u = y * ts->right.norm;
+  return draw_sampler(&ts->right, u < 1. ? u : 1.);
+}
+
+/**
+ * @brief Transform a uniform random number into a custom variate X = F^-1(u)
+ *
+ * @param ts The #tail_sampler for the distribution
+ * @param u Random number to be transformed
+ *
+ * The right tail is only resolved down to the spacing of u near 1. Use
+ * sample_tail_sampler() to generate deep right tail variates.
+ */
+double draw_tail_sampler(struct tail_sampler *ts, double u) {
+  if (u < ts->p_left) {
+    return draw_left_tail(ts, -log(u / ts->p_left));
+  } else if (u > 1. - ts->p_right) {
+    return draw_right_tail(ts, -log((1. - u) / ts->p_right));
+  } else {
+    double p_core = 1. - ts->p_left - ts->p_right;
+    return draw_sampler(&ts->core, (u - ts->p_left) / p_core);
+  }
+}
+
+/**
+ * @brief Generate a custom variate, with full relative precision in both
+ * tails
+ *
+ * @param ts The #tail_sampler for the distribution
+ * @param state The random number generator state
+ *
+ * One uniform random number selects the core or one of the tails. In a tail,
+ * a second uniform random number gives the exponential variate y.
+ */
+double sample_tail_sampler(struct tail_sampler *ts, rng_state *state) {
+  double u = sampleUniform(state);
+  if (u < ts->p_left) {
+    return draw_left_tail(ts, -log(sampleUniform(state)));
+  } else if (u > 1. - ts->p_right) {
+    return draw_right_tail(ts, -log(sampleUniform(state)));
+  } else {
+    double p_core = 1. - ts->p_left - ts->p_right;
+    return draw_sampler(&ts->core, (u - ts->p_left) / p_core);
+  }
+}
+
+/**
+ * @brief Generate an array of custom variates with sample_tail_sampler()
+ *
+ * @param ts The #tail_sampler for the distribution
+ * @param state The random number generator state
+ * @param x Output array of custom variates
+ * @param n Number of variates
+ */
+void sample_tail_sampler_batch(struct tail_sampler *ts, rng_state *state,
+                               double *x, int n) {
+  for (int i = 0; i < n; i++) {
+    x[i] = sample_tail_sampler(ts, state);
+  }
+}
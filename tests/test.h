@@ -0,0 +1,47 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+
+/* Minimal checking facilities shared by the tests */
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+/* Number of failed checks in the current test program */
+static int test_failures = 0;
+
+/* Report a failed condition without aborting the remaining checks */
+#define CHECK(cond, ...)                                                     \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            fprintf(stderr, "%s:%d: ", __FILE__, __LINE__);                  \
+            fprintf(stderr, __VA_ARGS__);                                    \
+            fprintf(stderr, "\n");                                           \
+            test_failures++;                                                 \
+        }                                                                    \
+    } while (0)
+
+/* Exit status of a test program */
+#define TEST_RESULT(name)                                                    \
+    (test_failures ? (fprintf(stderr, "%s: %d check(s) failed\n", name,      \
+                              test_failures), 1)                             \
+                   : (printf("%s: passed\n", name), 0))
+
+#endif
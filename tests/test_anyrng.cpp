@@ -0,0 +1,177 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+
+/* Tests of the header-only C++ front end. In deterministic mode, the C++
+ * samplers must give the same variates as the C API, bit by bit. */
+#include "../include/anyrng.hpp"
+#include "test.h"
+
+/* Standard headers */
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+/* Number of random numbers per comparison */
+#define TEST_NUM 100000
+
+static double fermi_dirac_pdf(double x, void *params) {
+    double *pars = (double *)params;
+    return (x <= 0.0) ? 0.0 : x * x / (std::exp((x - pars[1]) / pars[0]) + 1.0);
+}
+
+/* Uniform random numbers, including the endpoints of the search table cells */
+static std::vector<double> uniforms(int n) {
+    std::vector<double> u(n);
+    anyrng::Xoshiro256ss g(103);
+    for (int i=0; i<n; i++) {
+        u[i] = (i % 10 == 0) ? (double)(i % SEARCH_TABLE_LENGTH) /
+                               SEARCH_TABLE_LENGTH
+                             : anyrng::uniform_open(g);
+    }
+    return u;
+}
+
+template <class T>
+static bool same_bits(T a, T b) {
+    return std::memcmp(&a, &b, sizeof(T)) == 0;
+}
+
+/* The search tables generated by export_sampler must be those of the C API */
+static void test_export_tables() {
+    auto cs = anyrng::make_sampler([](double x) { return std::exp(-0.5 * x * x); },
+                                   -10.0, 10.0, 1e-10);
+    struct sampler s, t;
+    cs.export_sampler(&s);
+    t = s;
+    t.intervals = (struct interval *)std::malloc(s.intervalNum *
+                                                 sizeof(struct interval));
+    std::memcpy(t.intervals, s.intervals,
+                s.intervalNum * sizeof(struct interval));
+    t.index = NULL;
+    t.xindex = NULL;
+    build_search_table(&t);
+
+    int mismatches = 0;
+    for (int i=0; i<s.intervalNum; i++) {
+        if (s.intervals[i].id != t.intervals[i].id ||
+            s.intervals[i].nid != t.intervals[i].nid) mismatches++;
+    }
+    for (int k=0; k<SEARCH_TABLE_LENGTH; k++) {
+        if (s.index[k] != t.index[k] || s.xindex[k] != t.xindex[k]) {
+            mismatches++;
+        }
+    }
+    CHECK(mismatches == 0, "export_sampler: %d table entries differ",
+          mismatches);
+    clean_sampler(&s);
+    clean_sampler(&t);
+}
+
+/* Float tables must meet the tolerance after rounding, or report that they
+ * cannot */
+static void test_float_tolerance(double tol) {
+    double pars[2] = {1.0, 0.0};
+    struct sampler ref;
+    init_sampler(&ref, fermi_dirac_pdf, NULL, 1e-5, 25.0, 1e-12, pars);
+    auto fd = [&pars](double x) { return fermi_dirac_pdf(x, pars); };
+
+    anyrng::Sampler<decltype(fd), float> fs(fd, 1e-5, 25.0, tol);
+    CHECK(fs.accurate(), "float tables not accurate for tol = %g", tol);
+    double max_error = 0.;
+    for (int i=0; i<TEST_NUM; i++) {
+        float u = (i + 0.5f) / TEST_NUM;
+        double e = std::fabs(sampler_cdf(&ref, fs.invert(u)) - u);
+        if (!(e <= max_error)) max_error = e;
+    }
+    CHECK(max_error <= tol, "float error %g for tol = %g", max_error, tol);
+    clean_sampler(&ref);
+
+    /* The resolution of a float cannot be beaten */
+    anyrng::Sampler<decltype(fd), float> fine(fd, 1e-5, 25.0, 1e-9);
+    CHECK(!fine.accurate(), "float tables claim to meet tol = 1e-9");
+}
+
+#ifdef ANYRNG_DETERMINISTIC
+/* Tables imported from the C API must give the same variates */
+static void test_import(const std::vector<double> &u) {
+    double pars[2] = {1.0, 0.0};
+    struct sampler s;
+    init_sampler(&s, fermi_dirac_pdf, NULL, 1e-5, 25.0, 1e-10, pars);
+    auto fd = [&pars](double x) { return fermi_dirac_pdf(x, pars); };
+
+    auto cs = anyrng::Sampler<decltype(fd)>::import_sampler(fd, &s);
+    int mismatches = 0;
+    for (double v : u) {
+        if (!same_bits(cs.invert(v), draw_sampler(&s, v))) mismatches++;
+    }
+    CHECK(mismatches == 0, "import_sampler: %d variates differ", mismatches);
+
+    /* Float tables, compared with hermite_cubicf on the rounded tables */
+    auto fs = anyrng::Sampler<decltype(fd), float>::import_sampler(fd, &s);
+    mismatches = 0;
+    for (double v : u) {
+        float uf = static_cast<float>(v);
+        int i = 0;
+        while (i < s.intervalNum - 1 &&
+               static_cast<float>(s.intervals[i + 1].Fl) < uf) i++;
+        const struct interval *iv = &s.intervals[i];
+        float Fl = static_cast<float>(iv->Fl);
+        float Fr = (i < s.intervalNum - 1)
+                 ? static_cast<float>(s.intervals[i + 1].Fl) : 1.f;
+        float t = (uf - Fl) / (Fr - Fl);
+        float ref = std::fmaf(t, std::fmaf(t, std::fmaf(t, (float)iv->a3,
+                              (float)iv->a2), (float)iv->a1), (float)iv->a0);
+        if (!same_bits(fs.invert(uf), ref)) mismatches++;
+    }
+    CHECK(mismatches == 0, "import_sampler (float): %d variates differ",
+          mismatches);
+
+    clean_sampler(&s);
+}
+
+/* Tables exported to the C API must give the same variates */
+static void test_export(const std::vector<double> &u) {
+    auto cs = anyrng::make_sampler([](double x) { return std::exp(-0.5 * x * x); },
+                                   -10.0, 10.0, 1e-10);
+    struct sampler s;
+    cs.export_sampler(&s);
+    int mismatches = 0;
+    for (double v : u) {
+        if (!same_bits(cs.invert(v), draw_sampler(&s, v))) mismatches++;
+    }
+    CHECK(mismatches == 0, "export_sampler: %d variates differ", mismatches);
+    clean_sampler(&s);
+}
+#endif
+
+int main() {
+    std::vector<double> u = uniforms(TEST_NUM);
+
+    test_export_tables();
+    test_float_tolerance(1e-5);
+    test_float_tolerance(1e-6);
+
+#ifdef ANYRNG_DETERMINISTIC
+    test_import(u);
+    test_export(u);
+#endif
+
+    return TEST_RESULT("test_anyrng");
+}
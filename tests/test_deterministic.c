@@ -0,0 +1,478 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+
+/* Bitwise comparison of all code paths in deterministic mode. Every path is
+ * compared with a reference implementation in this file, which locates the
+ * interval by bisection instead of with the search tables and evaluates the
+ * cubics with explicit fused multiply-adds. A checksum of all variates is
+ * printed, which must not depend on the compiler flags. */
+#ifndef ANYRNG_DETERMINISTIC
+#error "This test must be compiled with -DANYRNG_DETERMINISTIC"
+#endif
+
+#include "../include/random.h"
+#include "../include/numa_sampler.h"
+#include "../include/sampler_float.h"
+#include "../include/tail_sampler.h"
+#include "../include/tabulated.h"
+#include "../include/sampler2d.h"
+#include "../include/sampler_compressed.h"
+#include "test.h"
+
+/* A header generated with the main program */
+#include "../fermi_dirac.h"
+
+/* Standard headers */
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+/* Number of random numbers per code path */
+#define TEST_NUM 100000
+
+/* FNV-1a hash of the bits of all compared variates */
+static uint64_t checksum = 14695981039346656037ULL;
+
+static void hash_bits(const void *p, size_t size) {
+    const unsigned char *c = (const unsigned char *)p;
+    for (size_t k=0; k<size; k++) {
+        checksum = (checksum ^ c[k]) * 1099511628211ULL;
+    }
+}
+
+/* Compare a code path with the reference, bit by bit */
+static void compare(const char *name, const double *ref, const double *x,
+                    int n) {
+    int mismatches = 0;
+    for (int i=0; i<n; i++) {
+        if (memcmp(&ref[i], &x[i], sizeof(double)) != 0) mismatches++;
+    }
+    CHECK(mismatches == 0, "%s: %d of %d variates differ", name, mismatches,
+          n);
+    hash_bits(x, n * sizeof(double));
+}
+
+static void comparef(const char *name, const float *ref, const float *x,
+                     int n) {
+    int mismatches = 0;
+    for (int i=0; i<n; i++) {
+        if (memcmp(&ref[i], &x[i], sizeof(float)) != 0) mismatches++;
+    }
+    CHECK(mismatches == 0, "%s: %d of %d variates differ", name, mismatches,
+          n);
+    hash_bits(x, n * sizeof(float));
+}
+
+/* Reference for draw_sampler: the first interval with F(r) >= u */
+static double ref_draw(const struct sampler *s, double u) {
+    int lo = 0, hi = s->intervalNum - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (s->intervals[mid].Fr >= u) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    const struct interval *iv = &s->intervals[lo];
+    double t = (u - iv->Fl) / (iv->Fr - iv->Fl);
+    return fma(t, fma(t, fma(t, iv->a3, iv->a2), iv->a1), iv->a0);
+}
+
+/* Reference for draw_sampler_float */
+static float ref_drawf(const struct sampler_float *sf, float u) {
+    int lo = 0, hi = sf->intervalNum - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (sf->endpoints[mid + 1] >= u) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    const float *a = &sf->splines[4 * lo];
+    float t = (u - sf->endpoints[lo]) /
+              (sf->endpoints[lo + 1] - sf->endpoints[lo]);
+    return fmaf(t, fmaf(t, fmaf(t, a[3], a[2]), a[1]), a[0]);
+}
+
+/* Reference for draw_sampler_compressed, decoding only the final interval */
+static double ref_draw_compressed(const struct sampler_compressed *sc,
+                                  double u) {
+    int lo = 0, hi = sc->intervalNum - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (compressed_cdf(sc, mid + 1) >= u) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    const struct compressed_block *b = &sc->blocks[lo / COMPRESSED_BLOCK_SIZE];
+    const struct compressed_interval *iv = &sc->intervals[lo];
+    double a0 = b->x0 + b->x_scale * iv->a0;
+    double a1 = b->a1_scale * iv->a1;
+    double a2 = b->a2_scale * iv->a2;
+    double a3 = b->a3_scale * iv->a3;
+    double Fl = compressed_cdf(sc, lo);
+    double Fr = compressed_cdf(sc, lo + 1);
+    double t = (u - Fl) / (Fr - Fl);
+    return fma(t, fma(t, fma(t, a3, a2), a1), a0);
+}
+
+/* Reference for the transform methods of the generated header */
+static int ref_header_search(double u) {
+    int lo = 0, hi = anyrng.intervalNum - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (anyrng.endpoints[mid + 1] >= u) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+}
+
+static double ref_header(const struct spline *table, double u) {
+    int i = ref_header_search(u);
+    float Fl = anyrng.endpoints[i];
+    float Fr = anyrng.endpoints[i + 1];
+    const struct spline *iv = &table[i];
+    double t = (u - Fl) / (Fr - Fl);
+    return fma(t, fma(t, fma(t, (double)iv->a3, iv->a2), iv->a1), iv->a0);
+}
+
+static float ref_headerf(float u) {
+    int i = ref_header_search(u);
+    float Fl = anyrng.endpoints[i];
+    float Fr = anyrng.endpoints[i + 1];
+    const struct spline *iv = &anyrng.splines[i];
+    float t = (u - Fl) / (Fr - Fl);
+    return fmaf(t, fmaf(t, fmaf(t, iv->a3, iv->a2), iv->a1), iv->a0);
+}
+
+/* Fermi-Dirac distribution, as in the main program */
+static double fermi_dirac_pdf(double x, void *params) {
+    double *pars = (double *)params;
+    return (x <= 0.0) ? 0.0 : x * x / (exp((x - pars[1]) / pars[0]) + 1.0);
+}
+
+static double normal_pdf(double x, void *params) {
+    return exp(-0.5 * x * x);
+}
+
+/* Bivariate normal distribution with correlation coefficient rho */
+static double bivariate_pdf(double x, double y, void *params) {
+    double rho = *(double *)params;
+    return exp(-(x * x - 2 * rho * x * y + y * y) / (2 * (1 - rho * rho)));
+}
+
+static int compare_double(const void *a, const void *b) {
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+/* The basic, batch, sorted, NUMA, truncated and compressed paths */
+static void test_library(const double *u, double *ref, double *x, int n) {
+    double pars[2] = {1.0, 0.0};
+    struct sampler s;
+    init_sampler(&s, fermi_dirac_pdf, NULL, 1e-5, 25.0, 1e-10, pars);
+
+    for (int i=0; i<n; i++) ref[i] = ref_draw(&s, u[i]);
+    for (int i=0; i<n; i++) x[i] = draw_sampler(&s, u[i]);
+    compare("draw_sampler", ref, x, n);
+    draw_sampler_batch(&s, u, x, n);
+    compare("draw_sampler_batch", ref, x, n);
+
+    struct numa_sampler ns;
+    init_numa_sampler(&ns, &s);
+    int maxThreads = omp_get_max_threads();
+    for (int threads=1; threads<=4; threads*=2) {
+        omp_set_num_threads(threads);
+        draw_numa_sampler_batch(&ns, u, x, n);
+        compare("draw_numa_sampler_batch", ref, x, n);
+    }
+    omp_set_num_threads(maxThreads);
+    clean_numa_sampler(&ns);
+
+    double *sorted = malloc(n * sizeof(double));
+    memcpy(sorted, u, n * sizeof(double));
+    qsort(sorted, n, sizeof(double), compare_double);
+    draw_sampler_sorted_batch(&s, sorted, x, n);
+    for (int i=0; i<n; i++) sorted[i] = ref_draw(&s, sorted[i]);
+    compare("draw_sampler_sorted_batch", sorted, x, n);
+    free(sorted);
+
+    /* Truncation to [a, b] maps u onto [F(a), F(b)] */
+    double a = 2.0, b = 4.5;
+    double Fa = sampler_cdf(&s, a);
+    double Fb = sampler_cdf(&s, b);
+    for (int i=0; i<n; i++) {
+        double X = ref_draw(&s, Fa + u[i] * (Fb - Fa));
+        ref[i] = (X < a) ? a : (X > b) ? b : X;
+    }
+    draw_sampler_truncated_batch(&s, a, b, u, x, n);
+    compare("draw_sampler_truncated_batch", ref, x, n);
+    for (int i=0; i<n; i++) x[i] = draw_sampler_truncated(&s, a, b, u[i]);
+    compare("draw_sampler_truncated", ref, x, n);
+    struct sampler_truncation t;
+    CHECK(init_sampler_truncation(&s, &t, a, b) == 0,
+          "init_sampler_truncation rejected [%g, %g]", a, b);
+    draw_sampler_truncation_batch(&s, &t, u, x, n);
+    compare("draw_sampler_truncation_batch", ref, x, n);
+    for (int i=0; i<n; i++) x[i] = draw_sampler_truncation(&s, &t, u[i]);
+    compare("draw_sampler_truncation", ref, x, n);
+
+    struct sampler_compressed sc;
+    compress_sampler(&sc, &s, 1e-10);
+    for (int i=0; i<n; i++) ref[i] = ref_draw_compressed(&sc, u[i]);
+    for (int i=0; i<n; i++) x[i] = draw_sampler_compressed(&sc, u[i]);
+    compare("draw_sampler_compressed", ref, x, n);
+    draw_sampler_compressed_batch(&sc, u, x, n);
+    compare("draw_sampler_compressed_batch", ref, x, n);
+    clean_sampler_compressed(&sc);
+
+    clean_sampler(&s);
+}
+
+/* Single-precision tables */
+static void test_float(const double *u, int n) {
+    double pars[2] = {1.0, 0.0};
+    struct sampler_float sf;
+    int err = init_sampler_float(&sf, fermi_dirac_pdf, 1e-5, 25.0, 1e-5,
+                                 pars);
+    CHECK(err == 0, "init_sampler_float failed");
+    if (err) return;
+
+    float *uf = malloc(n * sizeof(float));
+    float *ref = malloc(n * sizeof(float));
+    float *x = malloc(n * sizeof(float));
+    for (int i=0; i<n; i++) uf[i] = (float)u[i];
+
+    for (int i=0; i<n; i++) ref[i] = ref_drawf(&sf, uf[i]);
+    for (int i=0; i<n; i++) x[i] = draw_sampler_float(&sf, uf[i]);
+    comparef("draw_sampler_float", ref, x, n);
+    draw_sampler_float_batch(&sf, uf, x, n);
+    comparef("draw_sampler_float_batch", ref, x, n);
+
+    free(uf);
+    free(ref);
+    free(x);
+    clean_sampler_float(&sf);
+}
+
+/* Core and tail tables */
+static void test_tails(const double *u, double *ref, double *x, int n) {
+    struct tail_sampler ts;
+    CHECK(init_tail_sampler(&ts, normal_pdf, -40.0, 40.0, 1e-3, 1e-3, 1e-10,
+                            NULL) == 0, "tail tables do not meet the tolerance");
+
+    /* Map half of the random numbers into the tails */
+    double *v = malloc(n * sizeof(double));
+    for (int i=0; i<n; i++) {
+        v[i] = (i % 4 == 0) ? u[i] * 2e-3 :
+               (i % 4 == 1) ? 1. - u[i] * 2e-3 : u[i];
+    }
+
+    for (int i=0; i<n; i++) {
+        if (v[i] < ts.p_left) {
+            double w = 1. + log(v[i] / ts.p_left) * ts.left.norm;
+            ref[i] = ref_draw(&ts.left, w > 0. ? w : 0.);
+        } else if (v[i] > 1. - ts.p_right) {
+            double w = -log((1. - v[i]) / ts.p_right) * ts.right.norm;
+            ref[i] = ref_draw(&ts.right, w < 1. ? w : 1.);
+        } else {
+            double p_core = 1. - ts.p_left - ts.p_right;
+            ref[i] = ref_draw(&ts.core, (v[i] - ts.p_left) / p_core);
+        }
+    }
+    for (int i=0; i<n; i++) x[i] = draw_tail_sampler(&ts, v[i]);
+    compare("draw_tail_sampler", ref, x, n);
+    free(v);
+
+    /* The batch version must consume the random numbers in the same way */
+    rng_state seed = rand_uint64_init(107);
+    for (int i=0; i<n; i++) ref[i] = sample_tail_sampler(&ts, &seed);
+    seed = rand_uint64_init(107);
+    sample_tail_sampler_batch(&ts, &seed, x, n);
+    compare("sample_tail_sampler_batch", ref, x, n);
+
+    clean_tail_sampler(&ts);
+}
+
+/* Mixed discrete and continuous distributions */
+static void test_mixed(const double *u, double *ref, double *x, int n) {
+    struct sampler s;
+    init_sampler(&s, normal_pdf, NULL, -5.0, 5.0, 1e-10, NULL);
+    const double atoms[3] = {1.0, -0.5, 3.0};
+    const double probs[3] = {0.1, 0.2, 0.05};
+    struct mixed_sampler ms;
+    init_mixed_sampler(&ms, &s, 0.65, atoms, probs, 3);
+
+    for (int i=0; i<n; i++) {
+        int lo = -1;
+        while (lo + 1 < ms.atomNum && ms.G_lo[lo + 1] <= u[i]) lo++;
+        if (lo >= 0 && u[i] < ms.G_lo[lo] + ms.probs[lo]) {
+            ref[i] = ms.atoms[lo];
+        } else {
+            double P = (lo >= 0) ? ms.P[lo] : 0.;
+            double v = (u[i] - P) / ms.weight;
+            ref[i] = ref_draw(&s, (v < 0.) ? 0. : (v > 1.) ? 1. : v);
+        }
+    }
+    for (int i=0; i<n; i++) x[i] = draw_mixed_sampler(&ms, u[i]);
+    compare("draw_mixed_sampler", ref, x, n);
+    draw_mixed_sampler_batch(&ms, u, x, n);
+    compare("draw_mixed_sampler_batch", ref, x, n);
+
+    clean_mixed_sampler(&ms);
+    clean_sampler(&s);
+}
+
+/* Joint distributions */
+static void test_2d(const double *u, double *ref, double *x, int n) {
+    double rho = 0.8;
+    struct sampler2d s2;
+    int err = init_sampler2d(&s2, bivariate_pdf, -4.0, 4.0, -4.0, 4.0, 1e-6,
+                             &rho);
+    CHECK(err == 0, "init_sampler2d failed");
+    if (err) return;
+
+    /* Pairs are formed from consecutive random numbers */
+    int m = n / 2;
+    double *v = malloc(m * sizeof(double));
+    double *w = malloc(m * sizeof(double));
+    double *ref_y = malloc(m * sizeof(double));
+    double *y = malloc(m * sizeof(double));
+    for (int i=0; i<m; i++) {
+        v[i] = u[2 * i];
+        w[i] = u[2 * i + 1];
+    }
+
+    for (int i=0; i<m; i++) {
+        double X = ref_draw(&s2.marginal, v[i]);
+        int k = 0;
+        while (k < s2.gridNum - 2 && s2.grid[k + 1] <= X) k++;
+        double t = (X - s2.grid[k]) / (s2.grid[k + 1] - s2.grid[k]);
+        double y0 = ref_draw(&s2.conditionals[k], w[i]);
+        double y1 = ref_draw(&s2.conditionals[k + 1], w[i]);
+        ref[i] = X;
+        ref_y[i] = y0 + t * (y1 - y0);
+    }
+    for (int i=0; i<m; i++) draw_sampler2d(&s2, v[i], w[i], &x[i], &y[i]);
+    compare("draw_sampler2d (x)", ref, x, m);
+    compare("draw_sampler2d (y)", ref_y, y, m);
+    draw_sampler2d_batch(&s2, v, w, x, y, m);
+    compare("draw_sampler2d_batch (x)", ref, x, m);
+    compare("draw_sampler2d_batch (y)", ref_y, y, m);
+
+    free(v);
+    free(w);
+    free(ref_y);
+    free(y);
+    clean_sampler2d(&s2);
+}
+
+/* The transform methods of the generated header */
+static void test_header(const double *u, double *ref, double *x, int n) {
+    double *density = malloc(n * sizeof(double));
+    double *ref_density = malloc(n * sizeof(double));
+
+    for (int i=0; i<n; i++) ref[i] = ref_header(anyrng.splines, u[i]);
+    for (int i=0; i<n; i++) {
+        ref_density[i] = ref_header(anyrng.pdf_splines, u[i]);
+    }
+
+    for (int i=0; i<n; i++) x[i] = transform_variate(u[i]);
+    compare("transform_variate", ref, x, n);
+    transform_variate_batch(u, x, n);
+    compare("transform_variate_batch", ref, x, n);
+    anyrng_batch_scalar(u, x, NULL, n);
+    compare("transform_variate_batch (portable)", ref, x, n);
+#ifdef ANYRNG_MULTIVERSION
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        anyrng_batch_avx2(u, x, density, n);
+        compare("transform_variate_batch (AVX2)", ref, x, n);
+        compare("  density (AVX2)", ref_density, density, n);
+    }
+    if (__builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512vl")) {
+        anyrng_batch_avx512(u, x, density, n);
+        compare("transform_variate_batch (AVX-512)", ref, x, n);
+        compare("  density (AVX-512)", ref_density, density, n);
+    }
+#endif
+    for (int i=0; i<n; i++) {
+        x[i] = transform_variate_and_density(u[i], &density[i]);
+    }
+    compare("transform_variate_and_density", ref, x, n);
+    compare("  density", ref_density, density, n);
+    transform_variate_and_density_batch(u, x, density, n);
+    compare("transform_variate_and_density_batch", ref, x, n);
+    compare("  density", ref_density, density, n);
+    for (int i=0; i<n; i++) density[i] = transform_density(u[i]);
+    compare("transform_density", ref_density, density, n);
+
+    /* Single precision */
+    float *ref_f = (float *)ref_density;
+    float *x_f = (float *)density;
+    for (int i=0; i<n; i++) {
+        ref_f[i] = ref_headerf((float)u[i]);
+        x_f[i] = transform_variatef((float)u[i]);
+    }
+    comparef("transform_variatef", ref_f, x_f, n);
+
+    free(density);
+    free(ref_density);
+}
+
+int main() {
+    const int n = TEST_NUM;
+    double *u = malloc(n * sizeof(double));
+    double *ref = malloc(n * sizeof(double));
+    double *x = malloc(n * sizeof(double));
+
+    /* Random numbers, including the endpoints of the search table cells */
+    rng_state seed = rand_uint64_init(103);
+    for (int i=0; i<n; i++) {
+        u[i] = (i % 10 == 0) ? (double)(i % SEARCH_TABLE_LENGTH) /
+                               SEARCH_TABLE_LENGTH
+                             : sampleUniform(&seed);
+    }
+
+    test_library(u, ref, x, n);
+    test_float(u, n);
+    test_tails(u, ref, x, n);
+    test_mixed(u, ref, x, n);
+    test_2d(u, ref, x, n);
+    test_header(u, ref, x, n);
+
+    printf("checksum %016llx\n", (unsigned long long)checksum);
+
+    free(u);
+    free(ref);
+    free(x);
+    return TEST_RESULT("test_deterministic");
+}
@@ -0,0 +1,131 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+/* Tests of the distributed construction with the shared memory transport */
+#include "../include/random.h"
+#include "../include/distributed.h"
+#include "test.h"
+
+/* Standard headers */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Number of processes building the tables together */
+#define TEST_PROCESSES 4
+
+/* Fermi-Dirac-like pdf, most of whose intervals end up in one group */
+static double peaked_pdf(double x, void *params) {
+    double mu = *(double *)params;
+    return x * x / (exp((x - mu) / 0.05) + 1.0);
+}
+
+/* Compare two tables field by field, since the padding bytes of the
+ * intervals are not defined */
+static int tables_differ(const struct sampler *a, const struct sampler *b) {
+    if (a->intervalNum != b->intervalNum) return 1;
+    for (int i=0; i<a->intervalNum; i++) {
+        const struct interval *x = &a->intervals[i], *y = &b->intervals[i];
+        if (x->id != y->id || x->nid != y->nid || x->l != y->l ||
+            x->r != y->r || x->Fl != y->Fl || x->Fr != y->Fr ||
+            x->a0 != y->a0 || x->a1 != y->a1 || x->a2 != y->a2 ||
+            x->a3 != y->a3 || x->error != y->error) {
+            return 1;
+        }
+    }
+    return memcmp(a->index, b->index, SEARCH_TABLE_LENGTH * sizeof(double));
+}
+
+/* Build the tables with forked processes and compare them with a serial
+ * build in every process. Returns the number of processes whose tables
+ * differ, as seen by the parent. */
+static int build_and_compare(size_t capacity, double tol, int *ret) {
+    double mu = 1.0;
+    struct sampler serial;
+    int serial_ret = init_sampler(&serial, peaked_pdf, NULL, 1e-5, 25.0, tol,
+                                  &mu);
+
+    struct shm_transport t;
+    if (shm_transport_create(&t, TEST_PROCESSES, capacity) != 0) {
+        clean_sampler(&serial);
+        return -1;
+    }
+    int rank = shm_transport_fork(&t);
+    if (rank < 0) {
+        shm_transport_destroy(&t);
+        clean_sampler(&serial);
+        return -1;
+    }
+
+    struct sampler s;
+    *ret = init_sampler_distributed(&s, &t.base, peaked_pdf, NULL, 1e-5, 25.0,
+                                    tol, &mu);
+    int differs = (*ret != serial_ret);
+    if (*ret >= 0) {
+        differs |= (tables_differ(&s, &serial) != 0);
+        clean_sampler(&s);
+    }
+
+    /* Collect the outcome of every process in the parent */
+    void *recv;
+    size_t recv_bytes;
+    int failed = 0;
+    if (t.base.allgatherv(&t.base, &differs, sizeof(int), &recv,
+                          &recv_bytes) == 0) {
+        for (int r = 0; r < TEST_PROCESSES; r++) {
+            failed += ((int *)recv)[r];
+        }
+        free(recv);
+    } else {
+        failed = TEST_PROCESSES;
+    }
+
+    shm_transport_destroy(&t);
+    clean_sampler(&serial);
+    if (rank > 0) exit(0);
+    return failed;
+}
+
+/* The distributed tables must be identical to the serial ones, also when the
+ * capacity is only as large as the final table */
+static void test_distributed(double tol) {
+    int ret;
+    int failed = build_and_compare(0, tol, &ret);
+    CHECK(failed == 0, "%d process(es) differ for tol = %g", failed, tol);
+    CHECK(ret >= 0, "distributed build failed for tol = %g", tol);
+
+    double mu = 1.0;
+    struct sampler serial;
+    init_sampler(&serial, peaked_pdf, NULL, 1e-5, 25.0, tol, &mu);
+    size_t exact = serial.intervalNum * sizeof(struct interval);
+    clean_sampler(&serial);
+
+    failed = build_and_compare(exact, tol, &ret);
+    CHECK(failed == 0 && ret >= 0,
+          "build with the exact capacity failed for tol = %g", tol);
+
+    /* If the tables do not fit, all processes must fail together */
+    failed = build_and_compare(exact / 2, tol, &ret);
+    CHECK(ret == -1, "build with half the capacity returned %d", ret);
+}
+
+int main(void) {
+    test_distributed(1e-6);
+    test_distributed(1e-10);
+    return TEST_RESULT("test_distributed");
+}
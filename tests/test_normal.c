@@ -0,0 +1,168 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+/* Tests of the generators of standard normal variates */
+#include "../include/normal.h"
+#include "test.h"
+
+/* Standard headers */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Number of variates per generator */
+#define TEST_NUM 4000000
+
+/* Number of bins of width 0.1 on [-4.5, 4.5], plus one bin for each tail */
+#define TEST_BINS 92
+
+/* Start of the tail of the ziggurat */
+#define TEST_R 3.6541528853610088
+
+/* Probability of a standard normal variate in [a, b) */
+static double normal_prob(double a, double b) {
+    return 0.5 * (erfc(a / M_SQRT2) - erfc(b / M_SQRT2));
+}
+
+/* Check the moments, the probabilities of bins of width 0.1 and of the tails
+ * beyond the ziggurat base layer against the exact normal distribution */
+static void check_distribution(const double *x, long n, const char *name) {
+    double m1 = 0., m2 = 0., m4 = 0.;
+    long bins[TEST_BINS] = {0};
+    long tail = 0;
+    for (long i=0; i<n; i++) {
+        m1 += x[i];
+        m2 += x[i] * x[i];
+        m4 += x[i] * x[i] * x[i] * x[i];
+        int b = (int)floor((x[i] + 4.5) * 10.) + 1;
+        bins[b < 0 ? 0 : (b > TEST_BINS - 1 ? TEST_BINS - 1 : b)]++;
+        tail += (fabs(x[i]) >= TEST_R);
+    }
+    m1 /= n;
+    m2 /= n;
+    m4 /= n;
+
+    /* Five standard deviations of the estimators */
+    CHECK(fabs(m1) < 5. / sqrt(n), "%s: mean %g", name, m1);
+    CHECK(fabs(m2 - 1.) < 5. * sqrt(2. / n), "%s: variance %g", name, m2);
+    CHECK(fabs(m4 - 3.) < 5. * sqrt(96. / n), "%s: fourth moment %g", name,
+          m4);
+
+    /* Chi-squared test of the bins, with a generous threshold */
+    double chi2 = 0.;
+    for (int b=0; b<TEST_BINS; b++) {
+        double lo = (b == 0) ? -INFINITY : -4.5 + 0.1 * (b - 1);
+        double hi = (b == TEST_BINS - 1) ? INFINITY : -4.5 + 0.1 * b;
+        double expected = n * normal_prob(lo, hi);
+        chi2 += (bins[b] - expected) * (bins[b] - expected) / expected;
+    }
+    double dof = TEST_BINS - 1;
+    CHECK(chi2 < dof + 6. * sqrt(2. * dof), "%s: chi2 = %g for %g bins", name,
+          chi2, dof);
+
+    /* The tail beyond r is generated by a separate path of the ziggurat */
+    double p_tail = erfc(TEST_R / M_SQRT2);
+    CHECK(fabs(tail - n * p_tail) < 5. * sqrt(n * p_tail),
+          "%s: %ld variates beyond r, expected %g", name, tail, n * p_tail);
+}
+
+/* The layers must have the same area and close at the top */
+static void test_ziggurat_tables(const struct ziggurat *z) {
+    double v = z->x[0] * z->fx[1];
+    CHECK(z->x[1] == TEST_R && z->x[ZIGGURAT_LAYERS] == 0.,
+          "wrong edges of the ziggurat");
+    for (int i=1; i<ZIGGURAT_LAYERS; i++) {
+        CHECK(z->x[i + 1] < z->x[i], "edges not decreasing at layer %d", i);
+    }
+    double top = z->x[ZIGGURAT_LAYERS - 1] *
+                 (1. - z->fx[ZIGGURAT_LAYERS - 1]);
+    CHECK(fabs(top - v) < 1e-6 * v, "top layer has area %g instead of %g", top,
+          v);
+}
+
+/* The tail path of the ziggurat must follow the normal distribution beyond r,
+ * checked with many more tail variates than the full generator produces */
+static void test_ziggurat_tail(const struct ziggurat *z) {
+    const int nbins = 20;
+    long bins[20] = {0};
+    rng_state state = rand_uint64_init(204);
+    for (long i=0; i<TEST_NUM / 4; i++) {
+        double t = ziggurat_slow(z, &state, 0, (i % 2) ? 1. : -1.);
+        CHECK(fabs(t) >= TEST_R, "tail variate %g inside r", t);
+        int b = (int)((fabs(t) - TEST_R) * 10.);
+        bins[b < nbins - 1 ? b : nbins - 1]++;
+    }
+
+    /* Chi-squared test against the conditional distribution beyond r */
+    double p_tail = erfc(TEST_R / M_SQRT2);
+    double chi2 = 0.;
+    for (int b=0; b<nbins; b++) {
+        double lo = TEST_R + 0.1 * b;
+        double hi = (b == nbins - 1) ? INFINITY : lo + 0.1;
+        double expected = (TEST_NUM / 4) *
+                          (erfc(lo / M_SQRT2) - erfc(hi / M_SQRT2)) / p_tail;
+        chi2 += (bins[b] - expected) * (bins[b] - expected) / expected;
+    }
+    double dof = nbins - 1;
+    CHECK(chi2 < dof + 6. * sqrt(2. * dof), "tail: chi2 = %g for %g bins",
+          chi2, dof);
+}
+
+int main(void) {
+    double *x = malloc(TEST_NUM * sizeof(double));
+    double *y = malloc(TEST_NUM * sizeof(double));
+
+    struct ziggurat z;
+    init_ziggurat(&z);
+    test_ziggurat_tables(&z);
+    test_ziggurat_tail(&z);
+
+    /* Ziggurat, one by one and with fillNorm */
+    rng_state state = rand_uint64_init(201);
+    for (long i=0; i<TEST_NUM; i++) x[i] = sampleNormZiggurat(&z, &state);
+    check_distribution(x, TEST_NUM, "sampleNormZiggurat");
+    state = rand_uint64_init(201);
+    fillNorm(&z, &state, y, TEST_NUM);
+    CHECK(memcmp(x, y, TEST_NUM * sizeof(double)) == 0,
+          "fillNorm differs from sampleNormZiggurat");
+
+    /* Box-Mueller */
+    state = rand_uint64_init(202);
+    for (long i=0; i<TEST_NUM; i++) x[i] = sampleNorm(&state);
+    check_distribution(x, TEST_NUM, "sampleNorm");
+
+    /* Pairs, and the cached variant that returns the same sequence */
+    state = rand_uint64_init(203);
+    for (long i=0; i<TEST_NUM; i+=2) sampleNormPair(&state, &x[i], &x[i + 1]);
+    check_distribution(x, TEST_NUM, "sampleNormPair");
+    state = rand_uint64_init(203);
+    struct normal_cache cache = {0., 0};
+    for (long i=0; i<TEST_NUM; i++) y[i] = sampleNormCached(&state, &cache);
+    CHECK(memcmp(x, y, TEST_NUM * sizeof(double)) == 0,
+          "sampleNormCached differs from sampleNormPair");
+
+    /* The two variates of a pair must be uncorrelated */
+    double c = 0.;
+    for (long i=0; i<TEST_NUM; i+=2) c += x[i] * x[i + 1];
+    c /= TEST_NUM / 2;
+    CHECK(fabs(c) < 5. / sqrt(TEST_NUM / 2), "pair correlation %g", c);
+
+    free(x);
+    free(y);
+    return TEST_RESULT("test_normal");
+}
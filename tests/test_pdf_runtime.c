@@ -0,0 +1,81 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+/* Tests of pdfs given as expressions or loaded from shared objects */
+#include "../include/pdf_runtime.h"
+#include "test.h"
+
+/* Standard headers */
+#include <math.h>
+#include <string.h>
+
+/* A valid expression must evaluate like the C code it describes */
+static void test_expression(void) {
+    struct pdf_expression e;
+    double pars[2] = {1.0, 0.5};
+    int err = compile_pdf_expression(&e, "x^2 / (exp((x - p1) / p0) + 1)",
+                                     pars, 2);
+    CHECK(err == 0, "compilation failed: %s", e.error);
+    if (err == 0) {
+        double x = 1.5;
+        double ref = x * x / (exp((x - 0.5) / 1.0) + 1);
+        CHECK(fabs(eval_pdf_expression(x, &e) - ref) <= 1e-15 * ref,
+              "wrong value %g instead of %g", eval_pdf_expression(x, &e), ref);
+    }
+    clean_pdf_expression(&e);
+}
+
+/* Invalid expressions must be rejected with a description of the error */
+static void test_invalid(const char *source, const char *msg) {
+    struct pdf_expression e;
+    double pars[2] = {1.0, 0.5};
+    int err = compile_pdf_expression(&e, source, pars, 2);
+    CHECK(err != 0, "'%s' was accepted", source);
+    CHECK(strstr(e.error, msg) != NULL, "'%s' gave the error '%s'", source,
+          e.error);
+    clean_pdf_expression(&e);
+}
+
+/* Errors of the dynamic linker must be returned in the plugin, not printed */
+static void test_plugin(void) {
+    struct pdf_plugin pl;
+    CHECK(load_pdf_plugin(&pl, "/nonexistent/plugin.so", "pdf", NULL) != 0,
+          "missing shared object was loaded");
+    CHECK(strstr(pl.error, "nonexistent") != NULL, "error '%s'", pl.error);
+
+    CHECK(load_pdf_plugin(&pl, "libm.so.6", "anyrng_no_such_pdf", NULL) != 0,
+          "missing symbol was loaded");
+    CHECK(strstr(pl.error, "anyrng_no_such_pdf") != NULL, "error '%s'",
+          pl.error);
+
+    /* Any function with the signature of a pdf can be loaded */
+    CHECK(load_pdf_plugin(&pl, "libm.so.6", "exp", NULL) == 0,
+          "could not load exp from libm: %s", pl.error);
+    close_pdf_plugin(&pl);
+}
+
+int main(void) {
+    test_expression();
+    test_invalid("x * p1abc", "Unknown identifier");
+    test_invalid("p2 * x", "Unknown parameter");
+    test_invalid("p99999999999 * x", "Unknown parameter");
+    test_invalid("exp(x", "Expected ')'");
+    test_invalid("x $ 2", "Unexpected character");
+    test_plugin();
+    return TEST_RESULT("test_pdf_runtime");
+}
@@ -0,0 +1,88 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+/* Tests of the refinement and coarsening of initialized samplers */
+#include "../include/random.h"
+#include "test.h"
+
+/* Standard headers */
+#include <math.h>
+#include <stdlib.h>
+
+/* Number of stratified random numbers for the checks */
+#define TEST_NUM 100000
+
+static double fermi_dirac_pdf(double x, void *params) {
+    double *pars = (double *)params;
+    return x * x / (exp((x - pars[1]) / pars[0]) + 1.0);
+}
+
+static double normal_pdf(double x, void *params) {
+    (void)params;
+    return exp(-0.5 * x * x);
+}
+
+/* Largest error in u of the sampler, measured with the cdf of a much more
+ * accurate reference sampler */
+static double inversion_error(struct sampler *s, struct sampler *ref) {
+    double max_error = 0.;
+    for (int i=0; i<TEST_NUM; i++) {
+        double u = (i + 0.5) / TEST_NUM;
+        double e = fabs(sampler_cdf(ref, draw_sampler(s, u)) - u);
+        if (!(e <= max_error)) max_error = e;
+    }
+    return max_error;
+}
+
+/* Refined and coarsened tables must meet the new tolerance, and coarsened
+ * intervals may not cover more than 5% of the probability */
+static void test_refine_coarsen(pdf f, double *pars, double xl, double xr,
+                                const char *name) {
+    struct sampler s, ref;
+    init_sampler(&ref, f, NULL, xl, xr, 1e-13, pars);
+    init_sampler(&s, f, NULL, xl, xr, 1e-4, pars);
+
+    CHECK(refine_sampler(&s, 1e-9) == 0, "%s: refine_sampler failed", name);
+
+    double tols[3] = {1e-7, 1e-5, 1e-3};
+    for (int k=0; k<3; k++) {
+        CHECK(coarsen_sampler(&s, tols[k]) == 0, "%s: coarsen_sampler failed",
+              name);
+        double e = inversion_error(&s, &ref);
+        CHECK(e <= tols[k], "%s: error %g after coarsening to %g", name, e,
+              tols[k]);
+
+        double max_mass = 0.;
+        for (int i=0; i<s.intervalNum; i++) {
+            double mass = s.intervals[i].Fr - s.intervals[i].Fl;
+            if (mass > max_mass) max_mass = mass;
+        }
+        CHECK(max_mass <= 0.05, "%s: interval with probability %g at tol %g",
+              name, max_mass, tols[k]);
+    }
+
+    clean_sampler(&s);
+    clean_sampler(&ref);
+}
+
+int main(void) {
+    double pars[2] = {1.0, 0.0};
+    test_refine_coarsen(fermi_dirac_pdf, pars, 1e-5, 25.0, "fermi-dirac");
+    test_refine_coarsen(normal_pdf, NULL, -8.0, 8.0, "normal");
+    return TEST_RESULT("test_refine");
+}
@@ -0,0 +1,77 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+
+/* Tests of the two-dimensional sampler, including strongly correlated pdfs
+ * whose conditional slices have tails far below the double precision cdf */
+#include "../include/random.h"
+#include "../include/sampler2d.h"
+#include "test.h"
+
+/* Standard headers */
+#include <math.h>
+
+/* Number of pairs drawn for the moment checks */
+#define TEST_NUM 1000000
+
+/* Bivariate normal distribution with correlation coefficient rho */
+static double bivariate_pdf(double x, double y, void *params) {
+    double rho = *(double *)params;
+    return exp(-(x * x - 2 * rho * x * y + y * y) / (2 * (1 - rho * rho)));
+}
+
+static void test_bivariate(double rho, double tol) {
+    struct sampler2d s2;
+    int err = init_sampler2d(&s2, bivariate_pdf, -4.0, 4.0, -4.0, 4.0, tol,
+                             &rho);
+    CHECK(err == 0, "init_sampler2d failed for rho = %g, tol = %g", rho, tol);
+    if (err) return;
+
+    rng_state seed = rand_uint64_init(1234);
+    double tot_x = 0, tot_y = 0, cov = 0;
+    int outside = 0;
+    for (long i=0; i<TEST_NUM; i++) {
+        double x, y;
+        draw_sampler2d(&s2, sampleUniform(&seed), sampleUniform(&seed), &x, &y);
+        if (!(x >= -4.0 && x <= 4.0 && y >= -4.0 && y <= 4.0)) outside++;
+        tot_x += x;
+        tot_y += y;
+        cov += x * y;
+    }
+    clean_sampler2d(&s2);
+
+    double mean_x = tot_x / TEST_NUM;
+    double mean_y = tot_y / TEST_NUM;
+    cov = cov / TEST_NUM - mean_x * mean_y;
+    CHECK(outside == 0, "%d pairs outside the domain for rho = %g", outside,
+          rho);
+    CHECK(fabs(mean_x) < 0.01 && fabs(mean_y) < 0.01,
+          "means (%g, %g) for rho = %g", mean_x, mean_y, rho);
+    CHECK(fabs(cov - rho) < 0.01, "covariance %g for rho = %g", cov, rho);
+}
+
+int main() {
+    const double rhos[] = {0.5, 0.8, 0.9, 0.95, -0.8};
+    for (int i=0; i<5; i++) {
+        test_bivariate(rhos[i], 1e-6);
+        test_bivariate(rhos[i], 1e-3);
+    }
+
+    return TEST_RESULT("test_sampler2d");
+}
@@ -0,0 +1,291 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+/* Tests of the (de)serialization and the disk cache of samplers */
+#include "../include/random.h"
+#include "../include/sampler_cache.h"
+#include "test.h"
+
+/* Standard headers */
+#include <dirent.h>
+#include <stddef.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Offsets of the version and of the number of intervals in a saved sampler */
+#define VERSION_OFFSET 8
+#define INTERVAL_NUM_OFFSET 49
+
+/* Offset of the intervals, followed by the search tables */
+#define INTERVALS_OFFSET 53
+
+/* Unnormalized normal pdf with the mean given as parameter */
+static double normal_pdf(double x, void *params) {
+    double mu = *(double *)params;
+    return exp(-0.5 * (x - mu) * (x - mu));
+}
+
+/* Serialize a sampler into a buffer */
+static size_t save_to_buffer(const struct sampler *s, char **buf) {
+    FILE *f = tmpfile();
+    CHECK(save_sampler(s, f) == 0, "save_sampler failed");
+    size_t size = ftell(f);
+    rewind(f);
+    *buf = malloc(size);
+    CHECK(fread(*buf, 1, size, f) == size, "could not read back the file");
+    fclose(f);
+    return size;
+}
+
+/* Deserialize a sampler from a buffer */
+static int load_from_buffer(struct sampler *s, const char *buf, size_t size) {
+    FILE *f = tmpfile();
+    fwrite(buf, 1, size, f);
+    rewind(f);
+    int err = load_sampler(s, f);
+    fclose(f);
+    return err;
+}
+
+/* A saved sampler must be read back unchanged, while files with a different
+ * version, a truncated table or an implausible number of intervals must be
+ * rejected without allocating the announced tables */
+static void test_load(void) {
+    double mu = 0.5;
+    struct sampler s, t;
+    init_sampler(&s, normal_pdf, NULL, -8.0, 8.0, 1e-8, &mu);
+
+    char *buf;
+    size_t size = save_to_buffer(&s, &buf);
+    CHECK(load_from_buffer(&t, buf, size) == 0, "load_sampler failed");
+    CHECK(t.intervalNum == s.intervalNum &&
+          memcmp(t.intervals, s.intervals,
+                 s.intervalNum * sizeof(struct interval)) == 0 &&
+          memcmp(t.index, s.index, SEARCH_TABLE_LENGTH * sizeof(double)) == 0,
+          "tables differ after loading");
+    clean_sampler(&t);
+
+    CHECK(load_from_buffer(&t, buf, size - 1) != 0,
+          "truncated file was accepted");
+
+    char *bad = malloc(size);
+    memcpy(bad, buf, size);
+    bad[VERSION_OFFSET]++;
+    CHECK(load_from_buffer(&t, bad, size) != 0, "wrong version was accepted");
+
+    int nums[3] = {s.intervalNum + 1, MAX_INTERVAL_NUM + 1, 0x7fffffff};
+    for (int i=0; i<3; i++) {
+        memcpy(bad, buf, size);
+        memcpy(bad + INTERVAL_NUM_OFFSET, &nums[i], sizeof(int));
+        CHECK(load_from_buffer(&t, bad, size) != 0,
+              "file announcing %d intervals was accepted", nums[i]);
+    }
+
+    free(bad);
+    free(buf);
+    clean_sampler(&s);
+}
+
+/* Overwrite bytes of a saved sampler and check that it is rejected */
+static void check_corrupt(const char *buf, size_t size, size_t offset,
+                          const void *value, size_t value_size,
+                          const char *what) {
+    struct sampler t;
+    char *bad = malloc(size);
+    memcpy(bad, buf, size);
+    memcpy(bad + offset, value, value_size);
+    CHECK(load_from_buffer(&t, bad, size) != 0, "%s was accepted", what);
+    free(bad);
+}
+
+/* Tables of the right size whose values would make the draws read out of
+ * bounds must be rejected */
+static void test_corrupt_tables(void) {
+    double mu = 0.5;
+    struct sampler s;
+    init_sampler(&s, normal_pdf, NULL, -8.0, 8.0, 1e-8, &mu);
+    char *buf;
+    size_t size = save_to_buffer(&s, &buf);
+
+    const int n = s.intervalNum;
+    const size_t iv = sizeof(struct interval);
+    const size_t index = INTERVALS_OFFSET + n * iv;
+    const size_t xindex = index + SEARCH_TABLE_LENGTH * sizeof(double);
+
+    double d = n;
+    check_corrupt(buf, size, index + 50 * sizeof(double), &d, sizeof(d),
+                  "search table entry out of range");
+    d = 1.5;
+    check_corrupt(buf, size, index + 50 * sizeof(double), &d, sizeof(d),
+                  "fractional search table entry");
+    int k = -1;
+    check_corrupt(buf, size, xindex + 10 * sizeof(int), &k, sizeof(k),
+                  "negative x search table entry");
+    k = n + 5;
+    check_corrupt(buf, size, INTERVALS_OFFSET + 3 * iv +
+                  offsetof(struct interval, nid), &k, sizeof(k),
+                  "link out of range");
+    d = s.intervals[3].l - 1e-3;
+    check_corrupt(buf, size, INTERVALS_OFFSET + 3 * iv +
+                  offsetof(struct interval, l), &d, sizeof(d),
+                  "gap between intervals");
+    d = s.intervals[2].Fl;
+    check_corrupt(buf, size, INTERVALS_OFFSET + 3 * iv +
+                  offsetof(struct interval, Fr), &d, sizeof(d),
+                  "decreasing cdf");
+    d = NAN;
+    check_corrupt(buf, size, INTERVALS_OFFSET + 3 * iv +
+                  offsetof(struct interval, a2), &d, sizeof(d),
+                  "non-finite coefficient");
+
+    free(buf);
+    clean_sampler(&s);
+}
+
+/* Remove the cache files and the directory */
+static void remove_dir(const char *dir) {
+    DIR *d = opendir(dir);
+    struct dirent *e;
+    char fname[4096];
+    while (d != NULL && (e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+        snprintf(fname, sizeof(fname), "%s/%s", dir, e->d_name);
+        remove(fname);
+    }
+    if (d != NULL) closedir(d);
+    remove(dir);
+}
+
+/* Copy the contents of one file into another */
+static void copy_file(const char *src, const char *dst) {
+    char buf[4096];
+    size_t n;
+    FILE *in = fopen(src, "rb"), *out = fopen(dst, "wb");
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) fwrite(buf, 1, n, out);
+    fclose(in);
+    fclose(out);
+}
+
+/* Find a cache file in the directory that differs from the given one */
+static void find_file(const char *dir, const char *other, char *fname,
+                      size_t size) {
+    DIR *d = opendir(dir);
+    struct dirent *e;
+    fname[0] = '\0';
+    while ((e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+        snprintf(fname, size, "%s/%s", dir, e->d_name);
+        if (strcmp(fname, other) != 0) break;
+    }
+    closedir(d);
+}
+
+/* Tables must be found in memory and on disk only for the same key */
+static void test_disk_cache(void) {
+    char dir[] = "/tmp/anyrng_cache_XXXXXX";
+    CHECK(mkdtemp(dir) != NULL, "could not create a temporary directory");
+
+    double mu = 0.5;
+    struct sampler s;
+    struct sampler_cache c;
+    init_sampler_cache(&c, 4, dir);
+    int ret = cached_init_sampler(&c, &s, "normal", normal_pdf, NULL, -8.0,
+                                  8.0, 1e-8, &mu, sizeof(double));
+    CHECK(ret == 0, "first initialization returned %d", ret);
+    clean_sampler(&s);
+    ret = cached_init_sampler(&c, &s, "normal", normal_pdf, NULL, -8.0, 8.0,
+                              1e-8, &mu, sizeof(double));
+    CHECK(ret == 1, "sampler not found in memory, returned %d", ret);
+    clean_sampler(&s);
+    clean_sampler_cache(&c);
+    char first[4096], second[4096];
+    find_file(dir, "", first, sizeof(first));
+
+    /* A new cache must find the tables on disk, but only for the same key */
+    init_sampler_cache(&c, 4, dir);
+    ret = cached_init_sampler(&c, &s, "normal", normal_pdf, NULL, -8.0, 8.0,
+                              1e-8, &mu, sizeof(double));
+    CHECK(ret == 2, "sampler not found on disk, returned %d", ret);
+    CHECK(fabs(draw_sampler(&s, 0.5) - mu) < 1e-6, "wrong median %g",
+          draw_sampler(&s, 0.5));
+    clean_sampler(&s);
+    ret = cached_init_sampler(&c, &s, "normal2", normal_pdf, NULL, -8.0, 8.0,
+                              1e-8, &mu, sizeof(double));
+    CHECK(ret == 0, "sampler for another name returned %d", ret);
+    clean_sampler(&s);
+    clean_sampler_cache(&c);
+
+    /* Simulate a hash collision, the stored name must be compared */
+    find_file(dir, first, second, sizeof(second));
+    copy_file(first, second);
+    init_sampler_cache(&c, 4, dir);
+    ret = cached_init_sampler(&c, &s, "normal2", normal_pdf, NULL, -8.0, 8.0,
+                              1e-8, &mu, sizeof(double));
+    CHECK(ret == 0, "file of another name was used, returned %d", ret);
+    clean_sampler(&s);
+    mu = 0.25;
+    ret = cached_init_sampler(&c, &s, "normal", normal_pdf, NULL, -8.0, 8.0,
+                              1e-8, &mu, sizeof(double));
+    CHECK(ret == 0, "sampler for other parameters returned %d", ret);
+    clean_sampler(&s);
+    clean_sampler_cache(&c);
+
+    remove_dir(dir);
+}
+
+/* Step pdf, whose tables cannot meet small tolerances at the step */
+static double step_pdf(double x, void *params) {
+    (void)params;
+    return (x < 0.3) ? 1.0 : 2.0;
+}
+
+/* Tables that do not meet the tolerance must not be cached */
+static void test_inaccurate(void) {
+    char dir[] = "/tmp/anyrng_cache_XXXXXX";
+    CHECK(mkdtemp(dir) != NULL, "could not create a temporary directory");
+
+    struct sampler s;
+    struct sampler_cache c;
+    init_sampler_cache(&c, 4, dir);
+    for (int k=0; k<2; k++) {
+        int ret = cached_init_sampler(&c, &s, "step", step_pdf, NULL, 0.0, 1.0,
+                                      1e-6, NULL, 0);
+        CHECK(ret == -1, "inaccurate tables returned %d", ret);
+        clean_sampler(&s);
+    }
+    CHECK(c.entryNum == 0, "inaccurate tables were cached");
+    clean_sampler_cache(&c);
+
+    DIR *d = opendir(dir);
+    int files = 0;
+    struct dirent *e;
+    while (d != NULL && (e = readdir(d)) != NULL) files += (e->d_name[0] != '.');
+    if (d != NULL) closedir(d);
+    CHECK(files == 0, "inaccurate tables were written to disk");
+
+    remove_dir(dir);
+}
+
+int main(void) {
+    test_load();
+    test_corrupt_tables();
+    test_disk_cache();
+    test_inaccurate();
+    return TEST_RESULT("test_sampler_cache");
+}
@@ -0,0 +1,98 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+
+/* Tests of the background production of variates */
+#include "../include/random.h"
+#include "../include/sampler_stream.h"
+#include "test.h"
+
+/* Standard headers */
+#include <math.h>
+#include <time.h>
+
+/* Number of variates read by each consumer */
+#define TEST_NUM 1000000
+
+static double normal_pdf(double x, void *params) {
+    return exp(-0.5 * x * x);
+}
+
+struct consumer_task {
+    struct sampler_stream *st;
+    int consumer;
+    int mismatches;
+};
+
+/* Read the stream of one consumer and compare it with the variates that its
+ * producer should have generated, i.e. from the jumped generator */
+static void *consumer(void *arg) {
+    struct consumer_task *task = (struct consumer_task *)arg;
+    rng_state state = rand_uint64_init(42);
+    for (int j=0; j<task->consumer; j++) rand_uint64_jump(&state);
+
+    int read = 0;
+    task->mismatches = 0;
+    while (read < TEST_NUM) {
+        int got;
+        const double *x = sampler_stream_next(task->st, task->consumer, 100,
+                                              &got);
+        for (int i=0; i<got; i++) {
+            double ref = draw_sampler(task->st->s, sampleUniform(&state));
+            if (x[i] != ref) task->mismatches++;
+        }
+        read += got;
+    }
+    return NULL;
+}
+
+int main() {
+    struct sampler s;
+    init_sampler(&s, normal_pdf, NULL, -10.0, 10.0, 1e-10, NULL);
+
+    /* Small ring buffers, such that producers and consumers wait often */
+    const int consumers = 4;
+    struct sampler_stream st;
+    CHECK(sampler_stream_start(&st, &s, consumers, 256, 2, 42) == 0,
+          "sampler_stream_start failed");
+    pthread_t threads[4];
+    struct consumer_task tasks[4];
+    for (int c=0; c<consumers; c++) {
+        tasks[c].st = &st;
+        tasks[c].consumer = c;
+        pthread_create(&threads[c], NULL, consumer, &tasks[c]);
+    }
+    for (int c=0; c<consumers; c++) {
+        pthread_join(threads[c], NULL);
+        CHECK(tasks[c].mismatches == 0, "consumer %d: %d variates differ", c,
+              tasks[c].mismatches);
+    }
+
+    /* Producers with a full buffer must sleep instead of spinning */
+    clock_t cpu_start = clock();
+    struct timespec pause = {0, 200000000};
+    nanosleep(&pause, NULL);
+    double cpu_ms = 1e3 * (clock() - cpu_start) / CLOCKS_PER_SEC;
+    CHECK(cpu_ms < 50., "idle producers used %.0f ms of cpu time in 200 ms",
+          cpu_ms);
+    sampler_stream_stop(&st);
+
+    clean_sampler(&s);
+    return TEST_RESULT("test_sampler_stream");
+}
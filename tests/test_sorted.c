@@ -0,0 +1,126 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+/* Tests of the sorted and stratified sampling paths */
+#include "../include/random.h"
+#include "test.h"
+
+/* Standard headers */
+#include <math.h>
+#include <stdlib.h>
+
+/* Number of variates for the checks */
+#define TEST_NUM 200000
+
+static double normal_pdf(double x, void *params) {
+    (void)params;
+    return exp(-0.5 * x * x);
+}
+
+/* Sorted inversion must agree bitwise with element-wise inversion, also
+ * for arrays with large jumps, repeated values and the endpoints */
+static void test_sorted_batch(struct sampler *s) {
+    const int n = 1000;
+    double u[1000], x[1000];
+    rng_state state = rand_uint64_init(301);
+
+    /* Clusters separated by jumps over many intervals and table cells */
+    for (int k = 0; k < n; k++) {
+        u[k] = (k / 100) * 0.1 + 1e-6 * (k % 100 + sampleUniform(&state));
+    }
+    u[0] = 0.0;
+    u[500] = u[501] = u[499];
+    u[n - 1] = 1.0;
+
+    draw_sampler_sorted_batch(s, u, x, n);
+    int differ = 0;
+    for (int k = 0; k < n; k++) {
+        if (x[k] != draw_sampler(s, u[k])) differ++;
+    }
+    CHECK(differ == 0, "draw_sampler_sorted_batch: %d of %d variates differ",
+          differ, n);
+
+    /* A single element and an empty array */
+    double v = 0.7, y;
+    draw_sampler_sorted_batch(s, &v, &y, 1);
+    CHECK(y == draw_sampler(s, v), "draw_sampler_sorted_batch: single element");
+    draw_sampler_sorted_batch(s, u, x, 0);
+}
+
+/* Sorted variates must be non-decreasing and follow the distribution, by a
+ * Kolmogorov-Smirnov test against the cdf of the sampler */
+static void test_sorted(struct sampler *s) {
+    double *x = malloc(TEST_NUM * sizeof(double));
+    rng_state state = rand_uint64_init(302);
+    draw_sampler_sorted(s, &state, x, TEST_NUM);
+
+    int decreasing = 0;
+    double D = 0.;
+    for (int k = 0; k < TEST_NUM; k++) {
+        if (k > 0 && x[k] < x[k - 1]) decreasing++;
+        double F = sampler_cdf(s, x[k]);
+        double d = fmax(F - (double)k / TEST_NUM, (k + 1.0) / TEST_NUM - F);
+        if (!(d <= D)) D = d;
+    }
+    CHECK(decreasing == 0, "draw_sampler_sorted: %d decreasing steps",
+          decreasing);
+
+    /* Critical value at the 0.1% level */
+    double D_crit = 1.95 / sqrt(TEST_NUM);
+    CHECK(D < D_crit, "draw_sampler_sorted: KS statistic %g > %g", D, D_crit);
+
+    free(x);
+}
+
+/* Stratified variates must be non-decreasing, with exactly one variate in
+ * each quantile range [k/n, (k+1)/n) */
+static void test_stratified(struct sampler *s, int n) {
+    double *x = malloc(n * sizeof(double));
+    rng_state state = rand_uint64_init(303);
+    draw_sampler_stratified(s, &state, x, n);
+
+    int misplaced = 0, decreasing = 0;
+    double q = draw_sampler(s, 0.0);
+    for (int k = 0; k < n; k++) {
+        if (k > 0 && x[k] < x[k - 1]) decreasing++;
+        double q_next = draw_sampler(s, (k + 1.0) / n);
+        if (!(x[k] >= q && x[k] <= q_next)) misplaced++;
+        q = q_next;
+    }
+    CHECK(decreasing == 0, "draw_sampler_stratified(%d): %d decreasing steps",
+          n, decreasing);
+    CHECK(misplaced == 0,
+          "draw_sampler_stratified(%d): %d variates outside their quantile",
+          n, misplaced);
+
+    free(x);
+}
+
+int main() {
+    struct sampler s;
+    init_sampler(&s, normal_pdf, NULL, -10.0, 10.0, 1e-10, NULL);
+
+    test_sorted_batch(&s);
+    test_sorted(&s);
+    test_stratified(&s, 1);
+    test_stratified(&s, 7);
+    test_stratified(&s, TEST_NUM);
+
+    clean_sampler(&s);
+    return TEST_RESULT("test_sorted");
+}
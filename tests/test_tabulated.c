@@ -0,0 +1,146 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+
+/* Tests of samplers for tabulated pdfs and mixed distributions */
+#include "../include/random.h"
+#include "../include/tabulated.h"
+#include "test.h"
+
+/* Standard headers */
+#include <math.h>
+#include <stdlib.h>
+
+/* Number of grid points of the tabulated pdfs */
+#define TEST_POINTS 1025
+
+/* Number of stratified random numbers for the checks */
+#define TEST_NUM 100000
+
+/* Tabulate a normal pdf with the given mean and width on [a, b] */
+static int tabulate_normal(struct tabulated_pdf *t, double mu, double sigma,
+                           double a, double b) {
+    double x[TEST_POINTS], f[TEST_POINTS];
+    for (int i=0; i<TEST_POINTS; i++) {
+        x[i] = a + (b - a) * i / (TEST_POINTS - 1);
+        f[i] = exp(-0.5 * (x[i] - mu) * (x[i] - mu) / (sigma * sigma));
+    }
+    return init_tabulated_pdf(t, x, f, TEST_POINTS);
+}
+
+/* The sampler must invert the exact cdf of the tabulated pdf to within the
+ * tolerance, also for a pdf whose right tail has a probability of ~1e-31 */
+static void test_tabulated(double mu, double sigma, double tol) {
+    struct tabulated_pdf t;
+    CHECK(tabulate_normal(&t, mu, sigma, -4.0, 4.0) == 0,
+          "init_tabulated_pdf failed");
+
+    struct sampler s;
+    int err = init_sampler_tabulated(&s, &t, tol);
+    CHECK(err == 0, "init_sampler_tabulated failed for mu = %g, sigma = %g",
+          mu, sigma);
+
+    double total = tabulated_pdf_cdf(t.x[t.n - 1], &t);
+    double max_error = 0.;
+    for (int i=0; i<TEST_NUM; i++) {
+        double u = (i + 0.5) / TEST_NUM;
+        double x = draw_sampler(&s, u);
+        double e = fabs(tabulated_pdf_cdf(x, &t) / total - u);
+        if (!(e <= max_error)) max_error = e;
+    }
+    CHECK(max_error <= 2 * tol, "error %g for mu = %g, sigma = %g, tol = %g",
+          max_error, mu, sigma, tol);
+
+    clean_sampler(&s);
+    clean_tabulated_pdf(&t);
+}
+
+/* Point masses must be drawn with their exact probabilities, and the
+ * continuous part must be rescaled around them */
+static void test_mixed(void) {
+    struct tabulated_pdf t;
+    CHECK(tabulate_normal(&t, -2.85, 0.6, -4.0, 4.0) == 0,
+          "init_tabulated_pdf failed");
+    struct sampler s;
+    CHECK(init_sampler_tabulated(&s, &t, 1e-8) == 0,
+          "init_sampler_tabulated failed");
+
+    /* Atoms at the median of the continuous part and in its far tail */
+    double median = draw_sampler(&s, 0.5);
+    const double atoms[2] = {3.0, median};
+    const double probs[2] = {0.3, 0.2};
+    struct mixed_sampler ms;
+    init_mixed_sampler(&ms, &s, 0.5, atoms, probs, 2);
+
+    int count_median = 0, count_tail = 0, count_below = 0;
+    for (int i=0; i<TEST_NUM; i++) {
+        double x = draw_mixed_sampler(&ms, (i + 0.5) / TEST_NUM);
+        if (x == median) count_median++;
+        else if (x == 3.0) count_tail++;
+        else if (x < median) count_below++;
+    }
+    CHECK(abs(count_median - TEST_NUM / 5) <= 1, "%d draws at the median",
+          count_median);
+    CHECK(abs(count_tail - 3 * TEST_NUM / 10) <= 1, "%d draws in the tail",
+          count_tail);
+    CHECK(abs(count_below - TEST_NUM / 4) <= 2, "%d draws below the median",
+          count_below);
+
+    /* The batch version must agree with the scalar version */
+    double u[64], x[64];
+    for (int i=0; i<64; i++) u[i] = (i + 0.5) / 64;
+    draw_mixed_sampler_batch(&ms, u, x, 64);
+    for (int i=0; i<64; i++) {
+        CHECK(x[i] == draw_mixed_sampler(&ms, u[i]), "batch mismatch at %d",
+              i);
+    }
+    clean_mixed_sampler(&ms);
+
+    /* A purely discrete distribution */
+    init_mixed_sampler(&ms, NULL, 0., atoms, probs, 2);
+    int count_low = 0;
+    for (int i=0; i<TEST_NUM; i++) {
+        double v = draw_mixed_sampler(&ms, (i + 0.5) / TEST_NUM);
+        CHECK(v == median || v == 3.0, "draw %g is not an atom", v);
+        if (v == median) count_low++;
+    }
+    CHECK(abs(count_low - 2 * TEST_NUM / 5) <= 1, "%d draws at the median",
+          count_low);
+    clean_mixed_sampler(&ms);
+
+    clean_sampler(&s);
+    clean_tabulated_pdf(&t);
+}
+
+int main() {
+    /* Well-behaved tails */
+    test_tabulated(0.0, 1.0, 1e-6);
+    test_tabulated(0.0, 1.0, 1e-10);
+
+    /* A slice of a bivariate normal with rho = 0.8 at x = -3.5625, whose
+     * right tail has a probability of ~1e-31 */
+    test_tabulated(-2.85, 0.6, 1e-6);
+    test_tabulated(-2.85, 0.6, 1e-10);
+    test_tabulated(2.85, 0.6, 1e-6);
+    test_tabulated(-3.0, 0.3, 1e-6);
+
+    test_mixed();
+
+    return TEST_RESULT("test_tabulated");
+}
@@ -0,0 +1,111 @@
+/*******************************************************************************
+ * This file is part of AnyRNG.
+ * Copyright (c) 2021 Willem Elbers (whe@willemelbers.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+/* Tests of sampling from truncated distributions */
+#include "../include/random.h"
+#include "test.h"
+
+/* Standard headers */
+#include <math.h>
+
+/* Number of stratified random numbers for the checks */
+#define TEST_NUM 100000
+
+static double normal_pdf(double x, void *params) {
+    (void)params;
+    return exp(-0.5 * x * x);
+}
+
+/* Truncated draws must lie in the clamped range, invert the conditional cdf
+ * (F(x) - F(a)) / (F(b) - F(a)), measured with a much more accurate
+ * reference sampler, and agree with the scalar and batch entry points that
+ * take the endpoints directly */
+static void test_range(struct sampler *s, struct sampler *ref, double a,
+                       double b, double ta, double tb) {
+    struct sampler_truncation t;
+    CHECK(init_sampler_truncation(s, &t, a, b) == 0,
+          "[%g, %g]: init_sampler_truncation failed", a, b);
+    CHECK(t.a == ta && t.b == tb, "[%g, %g]: clamped to [%g, %g], not [%g, %g]",
+          a, b, t.a, t.b, ta, tb);
+
+    double u[TEST_NUM], x[TEST_NUM], y[TEST_NUM];
+    for (int i=0; i<TEST_NUM; i++) u[i] = (i + 0.5) / TEST_NUM;
+    draw_sampler_truncation_batch(s, &t, u, x, TEST_NUM);
+    draw_sampler_truncated_batch(s, a, b, u, y, TEST_NUM);
+
+    double Fa = sampler_cdf(ref, ta);
+    double mass = sampler_cdf(ref, tb) - Fa;
+    double max_error = 0.;
+    int outside = 0, differ = 0;
+    for (int i=0; i<TEST_NUM; i++) {
+        if (!(x[i] >= ta && x[i] <= tb)) outside++;
+        if (x[i] != y[i] || x[i] != draw_sampler_truncated(s, a, b, u[i]) ||
+            x[i] != draw_sampler_truncation(s, &t, u[i])) differ++;
+        double e = fabs((sampler_cdf(ref, x[i]) - Fa) / mass - u[i]);
+        if (!(e <= max_error)) max_error = e;
+    }
+
+    CHECK(outside == 0, "[%g, %g]: %d draws outside [%g, %g]", a, b, outside,
+          ta, tb);
+    CHECK(differ == 0, "[%g, %g]: %d draws differ between the entry points",
+          a, b, differ);
+    /* The error of the untruncated sampler is amplified by 1 / (F(b) - F(a)) */
+    CHECK(max_error * mass < 1e-8, "[%g, %g]: error %g in the conditional cdf",
+          a, b, max_error);
+}
+
+/* Reversed ranges, also after clamping, are rejected instead of sampled */
+static void test_invalid(struct sampler *s, double a, double b) {
+    struct sampler_truncation t;
+    CHECK(init_sampler_truncation(s, &t, a, b) == 1,
+          "[%g, %g]: init_sampler_truncation accepted the range", a, b);
+    CHECK(isnan(draw_sampler_truncation(s, &t, 0.5)),
+          "[%g, %g]: draw_sampler_truncation did not return NaN", a, b);
+    CHECK(isnan(draw_sampler_truncated(s, a, b, 0.5)),
+          "[%g, %g]: draw_sampler_truncated did not return NaN", a, b);
+
+    double u[2] = {0.25, 0.75}, x[2];
+    draw_sampler_truncated_batch(s, a, b, u, x, 2);
+    CHECK(isnan(x[0]) && isnan(x[1]),
+          "[%g, %g]: draw_sampler_truncated_batch did not return NaN", a, b);
+}
+
+int main() {
+    struct sampler s, ref;
+    init_sampler(&s, normal_pdf, NULL, -10.0, 10.0, 1e-10, NULL);
+    init_sampler(&ref, normal_pdf, NULL, -10.0, 10.0, 1e-13, NULL);
+
+    test_range(&s, &ref, -1.0, 2.0, -1.0, 2.0);
+    test_range(&s, &ref, 0.5, 3.0, 0.5, 3.0);
+    test_range(&s, &ref, -20.0, -1.0, -10.0, -1.0);
+    test_range(&s, &ref, 1.0, 50.0, 1.0, 10.0);
+    test_range(&s, &ref, -INFINITY, INFINITY, -10.0, 10.0);
+
+    /* A degenerate range returns its endpoint */
+    CHECK(draw_sampler_truncated(&s, 1.5, 1.5, 0.3) == 1.5,
+          "the range [1.5, 1.5] did not return 1.5");
+
+    test_invalid(&s, 2.0, 1.0);
+    test_invalid(&s, 12.0, 15.0);
+    test_invalid(&s, -15.0, -12.0);
+    test_invalid(&s, NAN, 1.0);
+
+    clean_sampler(&s);
+    clean_sampler(&ref);
+    return TEST_RESULT("test_truncated");
+}